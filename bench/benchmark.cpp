@@ -0,0 +1,1313 @@
+//
+//  benchmark.cpp
+//  hoppe
+//
+//  Created by apple on 16/10/2026.
+//
+//  Stand-alone benchmarks for the reconstruction building blocks and for
+//  every stage of the pipeline. Build the hoppe_bench target of the
+//  top-level CMakeLists.txt and run it from the repository root.
+//  Usage: hoppe_bench [benchmark] [max nodes] [results.json]
+//  Benchmarks: traverse_dfs, adjacency, mst, march, assets, synthetic, sdf,
+//  xyz, alloc, shared_knn, morton, check, or all. The check mode exits with 1
+//  when a check fails.
+//  Every result is printed as one tab separated line and, given a path,
+//  written as JSON so runs of two commits can be diffed.
+//
+
+#include <array>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <numeric>
+#include <vector>
+#include <utility>
+#include <atomic>
+#include <new>
+#include <cstring>
+#include <nanoflann.hpp>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include "UGraph.hpp"
+#include "CubeMarcher.hpp"
+#include "Hoppe.hpp"
+#include "Instrumentation.hpp"
+#include "SyntheticCloud.hpp"
+#include "ThreadPool.hpp"
+#include "MortonOrder.hpp"
+#include "MarchingCubesTables.hpp"
+#include "NormalSolver.hpp"
+
+
+// Heap allocations of the whole process, counted by the operators below
+static std::atomic<std::size_t> allocation_count { 0 };
+
+// Not inlined, so the compiler does not see malloc and free pair up
+// with delete and new at call sites and warn about a mismatch
+__attribute__((noinline)) auto operator new(std::size_t size) -> void * {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (auto p = std::malloc(size > 0 ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) auto operator delete(void *p) noexcept -> void {
+    std::free(p);
+}
+
+__attribute__((noinline)) auto operator delete(void *p, std::size_t) noexcept -> void {
+    std::free(p);
+}
+
+// Over-aligned types, like the cache aligned marching grids, come here.
+// The array and nothrow forms forward to these, so they are counted too.
+__attribute__((noinline)) auto operator new(std::size_t size, std::align_val_t alignment) -> void * {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    void *p = nullptr;
+    if (posix_memalign(&p, std::max(sizeof(void *), (std::size_t) alignment), size > 0 ? size : 1) == 0) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) auto operator delete(void *p, std::align_val_t) noexcept -> void {
+    std::free(p);
+}
+
+__attribute__((noinline)) auto operator delete(void *p, std::size_t, std::align_val_t) noexcept -> void {
+    std::free(p);
+}
+
+
+/// Hardware cache misses of the calling thread, where the kernel lets us
+/// count them. Reads -1 everywhere else.
+class CacheMissCounter {
+public:
+    CacheMissCounter() {
+#ifdef __linux__
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+    }
+
+    ~CacheMissCounter() {
+#ifdef __linux__
+        if (fd >= 0) {
+            close(fd);
+        }
+#endif
+    }
+
+    auto read_count() const -> double {
+#ifdef __linux__
+        std::uint64_t count = 0;
+        if (fd >= 0 && read(fd, &count, sizeof(count)) == sizeof(count)) {
+            return (double) count;
+        }
+#endif
+        return -1.0;
+    }
+
+private:
+    int fd = -1;
+};
+
+
+/// Bare xyz array for nanoflann, so graph benchmarks do not need OpenCV.
+struct BenchCloud {
+    inline auto kdtree_get_point_count() const -> std::size_t {
+        return xyz.size() / 3;
+    }
+
+    inline auto kdtree_get_pt(std::size_t idx, int dim) const -> float {
+        return xyz[idx * 3 + dim];
+    }
+
+    template<class BBox>
+    auto kdtree_get_bbox(BBox &) const -> bool {
+        return false;
+    }
+
+    std::vector<float> xyz;
+};
+
+typedef nanoflann::KDTreeSingleIndexAdaptor<
+    nanoflann::L2_Simple_Adaptor<float, BenchCloud>,
+    BenchCloud,
+    3
+> BenchCloudIndex;
+
+
+/// One measurement: what ran, on what, and named numbers.
+struct BenchResult {
+    std::string benchmark;
+    std::string config;
+    std::vector<std::pair<std::string, double> > metrics;
+};
+
+static std::vector<BenchResult> results;
+
+/// Prints a result as one line and keeps it for `write_json`.
+static auto record(const std::string &benchmark,
+                   const std::string &config,
+                   const std::vector<std::pair<std::string, double> > &metrics) -> void {
+    printf("%s\t%s", benchmark.c_str(), config.c_str());
+    for (const auto &metric : metrics) {
+        printf("\t%s=%.10g", metric.first.c_str(), metric.second);
+    }
+    printf("\n");
+    fflush(stdout);
+    results.push_back({ benchmark, config, metrics });
+}
+
+static auto write_json(const std::string &path) -> bool {
+    auto file = fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        fprintf(stderr, "Cannot write %s\n", path.c_str());
+        return false;
+    }
+    fprintf(file, "[");
+    for (auto i = 0ul; i < results.size(); i++) {
+        const auto &result = results[i];
+        fprintf(file, "%s\n  { \"benchmark\": \"%s\", \"config\": \"%s\", \"metrics\": {",
+                i == 0 ? "" : ",", result.benchmark.c_str(), result.config.c_str());
+        for (auto j = 0ul; j < result.metrics.size(); j++) {
+            fprintf(file, "%s \"%s\": %.12g", j == 0 ? "" : ",",
+                    result.metrics[j].first.c_str(), result.metrics[j].second);
+        }
+        fprintf(file, " } }");
+    }
+    fprintf(file, "\n]\n");
+    return fclose(file) == 0;
+}
+
+/// Runs `func` and returns its wall time in milliseconds.
+template<typename F>
+static auto time_ms(F func) -> double {
+    const auto begin = std::chrono::steady_clock::now();
+    func();
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - begin;
+    return elapsed.count();
+}
+
+/// Pool that samples and writes synthetic clouds; the pipelines run on their own.
+static auto cloud_pool() -> ThreadPool & {
+    static ThreadPool pool;
+    return pool;
+}
+
+/// Random tree over `num_nodes` nodes: node i hangs off a random earlier node.
+static auto synthetic_mst(std::size_t num_nodes, unsigned int seed) -> UGraph {
+    std::mt19937 rng(seed);
+    UGraph tree(num_nodes);
+    tree.edges.reserve(num_nodes - 1);
+    for (auto i = 1ul; i < num_nodes; i++) {
+        std::uniform_int_distribution<std::size_t> parent(0, i - 1);
+        tree.add_edge({ parent(rng), i, 0.0f });
+    }
+    std::shuffle(tree.edges.begin(), tree.edges.end(), rng);
+    return tree;
+}
+
+/// kNN graph over uniformly random points with random edge costs,
+/// shaped like the Riemannian graph built in Hoppe::fix_orientations.
+static auto synthetic_knn_graph(std::size_t num_nodes, int k, unsigned int seed) -> UGraph {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    BenchCloud cloud;
+    cloud.xyz.resize(num_nodes * 3);
+    for (auto &v : cloud.xyz) {
+        v = uniform(rng);
+    }
+    BenchCloudIndex index(3, cloud, nanoflann::KDTreeSingleIndexAdaptorParams(10));
+    index.buildIndex();
+
+    UGraph graph(num_nodes);
+    graph.edges.reserve(num_nodes * k);
+    std::vector<std::size_t> indices(k + 1);
+    std::vector<float> out_squared_dist(k + 1);
+    for (auto i = 0ul; i < num_nodes; i++) {
+        const auto count = index.knnSearch(&cloud.xyz[i * 3], k + 1, &indices[0], &out_squared_dist[0]);
+        for (auto j = 0ul; j < count; j++) {
+            if (indices[j] > i) {
+                graph.add_edge({ i, indices[j], uniform(rng) });
+            }
+        }
+    }
+    return graph;
+}
+
+/// Times both MST algorithms on the same graphs, so the default can be
+/// weighed against the parallel one on this machine's thread count.
+static auto bench_mst(std::size_t max_nodes) -> void {
+    ThreadPool pool;
+    for (auto num_nodes : { 100000ul, 1000000ul, 10000000ul }) {
+        if (num_nodes > max_nodes) {
+            break;
+        }
+        double ms[2], total_cost[2] = { 0.0, 0.0 };
+        auto num_edges = 0ul, mst_edges = 0ul;
+        const MSTAlgorithm algorithms[] = { MSTAlgorithm::kruskal, MSTAlgorithm::boruvka };
+        for (auto a = 0; a < 2; a++) {
+            // Kruskal sorts the edges in place, so every run gets the graph afresh
+            auto graph = synthetic_knn_graph(num_nodes, 8, 42);
+            num_edges = graph.edges.size();
+            ms[a] = time_ms([&] () {
+                const auto mst = graph.generate_mst(algorithms[a], &pool);
+                mst_edges = mst.edges.size();
+                for (const auto &edge : mst.edges) {
+                    total_cost[a] += edge.cost;
+                }
+            });
+        }
+        record("generate_mst", "nodes=" + std::to_string(num_nodes), {
+            { "edges", num_edges },
+            { "mst_edges", mst_edges },
+            { "threads", pool.size() },
+            { "kruskal_ms", ms[0] },
+            { "boruvka_ms", ms[1] },
+            { "boruvka_speedup", ms[0] / ms[1] },
+            { "cost_difference", std::fabs(total_cost[0] - total_cost[1]) }
+        });
+    }
+}
+
+static auto bench_traverse_dfs(std::size_t max_nodes) -> void {
+    for (auto num_nodes : { 10000ul, 100000ul, 1000000ul }) {
+        if (num_nodes > max_nodes) {
+            break;
+        }
+        const auto tree = synthetic_mst(num_nodes, 42);
+        auto visited = 0ul;
+        const auto ms = time_ms([&] () {
+            tree.traverse_dfs(0, [&] (int, int) {
+                visited++;
+            });
+        });
+        record("traverse_dfs", "nodes=" + std::to_string(num_nodes), { { "visited", visited }, { "ms", ms } });
+    }
+}
+
+static auto bench_adjacency(std::size_t max_nodes) -> void {
+    for (auto num_nodes : { 100000ul, 1000000ul, 10000000ul }) {
+        if (num_nodes > max_nodes) {
+            break;
+        }
+        const auto graph = synthetic_knn_graph(num_nodes, 8, 42);
+        auto num_neighbors = 0ul;
+        const auto ms = time_ms([&] () {
+            num_neighbors = graph.adjacency().neighbors.size();
+        });
+        record("adjacency", "nodes=" + std::to_string(num_nodes),
+               { { "edges", graph.edges.size() }, { "neighbors", num_neighbors }, { "ms", ms } });
+    }
+}
+
+/// Roughly even samples of the unit sphere, `count` of them.
+static auto fibonacci_sphere(std::size_t count) -> std::vector<cv::Point3f> {
+    std::vector<cv::Point3f> points(count);
+    const auto golden_angle = (float) (M_PI * (3.0 - std::sqrt(5.0)));
+    for (auto i = 0ul; i < count; i++) {
+        const auto z = 1.0f - 2.0f * (i + 0.5f) / count;
+        const auto r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+        const auto phi = golden_angle * i;
+        points[i] = cv::Point3f(r * std::cos(phi), r * std::sin(phi), z);
+    }
+    return points;
+}
+
+/// Marches a sphere through grids of growing size with every grid mode.
+/// The SDF is analytic and cheap, so the time is dominated by cell
+/// classification and triangulation. Every mode evaluates the same narrow
+/// band around samples of the sphere, so they all yield the same mesh.
+static auto bench_march(std::size_t max_nodes) -> void {
+    const auto radius = 0.8f;
+    for (auto n : { 64, 128, 256, 512 }) {
+        if ((std::size_t) n * n * n > max_nodes) {
+            break;
+        }
+        const auto resolution = 2.0f / n;
+        const cv::Point3f offset(-1.0f, -1.0f, -1.0f);
+        auto centers = fibonacci_sphere((std::size_t) n * n * 4);
+        for (auto &center : centers) {
+            center *= radius;
+        }
+        const std::pair<GridMode, const char *> modes[] = {
+            { GridMode::dense, "dense" },
+            { GridMode::sparse, "sparse" },
+            { GridMode::streaming, "streaming" }
+        };
+        for (const auto &mode : modes) {
+            CubeMarcher marcher;
+            const auto band_ms = time_ms([&] () {
+                marcher.init(cv::Vec3i(n, n, n), resolution, mode.first);
+                marcher.set_band(centers, 2.0f * resolution, offset);
+            });
+            const auto ms = time_ms([&] () {
+                marcher.march([&] (cv::Point3f p) -> std::optional<float> {
+                    return std::sqrt(p.dot(p)) - radius;
+                }, offset);
+            });
+            const auto num_cells = (double) (n - 1) * (n - 1) * (n - 1);
+            std::vector<std::pair<std::string, double> > metrics = {
+                { "triangles", marcher.indices.size() / 3 },
+                { "vertices", marcher.vertices.size() },
+                { "stored_vertices", marcher.stored_vertices() },
+                { "setup_ms", band_ms },
+                { "ms", ms },
+                { "mcells_per_s", num_cells / ms / 1000.0 }
+            };
+            for (const auto &stage : marcher.stages) {
+                metrics.push_back({ stage.name + "_ms", stage.wall_seconds * 1000.0 });
+            }
+            record("march", std::string(mode.second) + " grid=" + std::to_string(n), metrics);
+        }
+    }
+}
+
+/// Runs the whole pipeline on the cloud `hoppe` holds and records every stage.
+/// @param truth surface the cloud was sampled from, to measure the mesh error
+static auto bench_pipeline(const std::string &name, Hoppe &hoppe, const SyntheticCloud *truth = nullptr) -> void {
+    const auto report = hoppe.run();
+    if (!report.success) {
+        fprintf(stderr, "Skipping %s: cannot reconstruct it\n", name.c_str());
+        return;
+    }
+    const auto mesh_path = "bench_mesh.ply";
+    hoppe.export_mesh(mesh_path);
+    const auto stages = hoppe.last_report().stages;
+    std::remove(mesh_path);
+    std::remove("planecloud.ply");
+
+    auto total_ms = 0.0;
+    for (const auto &stage : stages) {
+        total_ms += stage.wall_seconds * 1000.0;
+        record("stage", name + " " + stage.name, {
+            { "wall_ms", stage.wall_seconds * 1000.0 },
+            { "cpu_ms", stage.cpu_seconds * 1000.0 },
+            { "peak_rss_mb", stage.peak_rss / 1048576.0 },
+            { "items", stage.items }
+        });
+    }
+    record("pipeline", name, { { "wall_ms", total_ms } });
+
+    if (truth != nullptr && !hoppe.mesh_vertices().empty()) {
+        // Distance of every mesh vertex to the true surface
+        auto sum = 0.0, squared_sum = 0.0, max = 0.0;
+        for (const auto &vertex : hoppe.mesh_vertices()) {
+            const auto error = (double) std::fabs(truth->sdf(vertex));
+            sum += error;
+            squared_sum += error * error;
+            max = std::max(max, error);
+        }
+        const auto count = (double) hoppe.mesh_vertices().size();
+        record("accuracy", name, {
+            { "mean_error", sum / count },
+            { "rms_error", std::sqrt(squared_sum / count) },
+            { "max_error", max },
+            { "resolution", hoppe.resolution() }
+        });
+    }
+}
+
+static auto bench_assets() -> void {
+    for (const auto name : { "bunny", "torus", "res" }) {
+        Hoppe hoppe;
+        hoppe.load_pointcloud(std::string("assets/") + name + ".xyz");
+        bench_pipeline(name, hoppe);
+    }
+}
+
+/// Reconstructs every synthetic shape from clouds larger than the bundled
+/// assets, fed in memory, and measures the mesh against the exact surface.
+static auto bench_synthetic(std::size_t max_nodes) -> void {
+    const SyntheticShape shapes[] = {
+        SyntheticShape::sphere,
+        SyntheticShape::torus,
+        SyntheticShape::box,
+        SyntheticShape::plane,
+        SyntheticShape::scene
+    };
+    for (auto num_points : { 10000ul, 100000ul, 1000000ul, 10000000ul }) {
+        if (num_points > max_nodes) {
+            break;
+        }
+        for (const auto shape : shapes) {
+            // The plane is the noisy one
+            const SyntheticCloud cloud(shape, shape == SyntheticShape::plane ? 0.01f : 0.0f);
+            Hoppe hoppe;
+            hoppe.set_pointcloud(cloud.sample(num_points, cloud_pool()));
+            bench_pipeline(std::string(SyntheticCloud::name(shape)) + std::to_string(num_points), hoppe, &cloud);
+        }
+    }
+}
+
+/// Times SDF queries alone, without the marching around them, against
+/// growing numbers of tangent planes. Queries are cloud points moved by up
+/// to one grid step, so they land in the narrow band the marcher samples.
+static auto bench_sdf(std::size_t max_nodes) -> void {
+    const SyntheticCloud cloud(SyntheticShape::sphere);
+    const auto num_queries = 1000000ul;
+    for (auto num_planes : { 10000ul, 100000ul, 1000000ul }) {
+        if (num_planes > max_nodes) {
+            break;
+        }
+        Hoppe hoppe;
+        hoppe.set_pointcloud(cloud.sample(num_planes, cloud_pool()));
+        if (!hoppe.run().success) {
+            fprintf(stderr, "Skipping sdf: cannot reconstruct %lu points\n", num_planes);
+            continue;
+        }
+        std::remove("planecloud.ply");
+
+        std::mt19937 rng(11);
+        std::uniform_int_distribution<std::size_t> pick(0, hoppe.points().size() - 1);
+        std::uniform_real_distribution<float> step(-hoppe.resolution(), hoppe.resolution());
+        std::vector<cv::Point3f> queries(num_queries);
+        for (auto &query : queries) {
+            query = hoppe.points()[pick(rng)] + cv::Point3f(step(rng), step(rng), step(rng));
+        }
+        auto hits = 0ul;
+        auto error = 0.0;
+        const auto query_ms = time_ms([&] () {
+            for (const auto &query : queries) {
+                if (const auto distance = hoppe.signed_distance(query)) {
+                    hits++;
+                    error += std::fabs(*distance - cloud.sdf(query));
+                }
+            }
+        });
+        record("sdf", "planes=" + std::to_string(num_planes), {
+            { "queries", num_queries },
+            { "us_per_query", query_ms * 1000.0 / num_queries },
+            { "hit_rate", (double) hits / num_queries },
+            { "mean_abs_error", hits > 0 ? error / hits : 0.0 }
+        });
+    }
+}
+
+/// Generates, writes and parses .xyz files of growing size.
+static auto bench_xyz(std::size_t max_nodes) -> void {
+    const auto path = "bench_cloud.xyz";
+    const SyntheticCloud cloud(SyntheticShape::sphere);
+    for (auto num_points : { 100000ul, 1000000ul, 10000000ul, 100000000ul }) {
+        if (num_points > max_nodes) {
+            break;
+        }
+        std::vector<cv::Point3f> points;
+        const auto sample_ms = time_ms([&] () {
+            points = cloud.sample(num_points, cloud_pool());
+        });
+        auto written = false;
+        const auto write_ms = time_ms([&] () {
+            written = SyntheticCloud::write_xyz(path, points, cloud_pool());
+        });
+        if (!written) {
+            fprintf(stderr, "Cannot write %s\n", path);
+            return;
+        }
+        auto file_size = 0.0;
+        if (auto file = fopen(path, "rb")) {
+            fseek(file, 0, SEEK_END);
+            file_size = ftell(file) / 1048576.0;
+            fclose(file);
+        }
+        Hoppe hoppe;
+        const auto load_ms = time_ms([&] () {
+            hoppe.load_pointcloud(path);
+        });
+        std::remove(path);
+        record("xyz", "points=" + std::to_string(num_points), {
+            { "sample_ms", sample_ms },
+            { "write_ms", write_ms },
+            { "load_ms", load_ms },
+            { "mb", file_size },
+            { "write_mb_per_s", file_size / write_ms * 1000.0 },
+            { "load_mb_per_s", file_size / load_ms * 1000.0 }
+        });
+    }
+}
+
+/// Counts heap allocations of kNN loops shaped like the ones in
+/// Hoppe::estimate_planes, with a fresh result vector pair per query and
+/// with one NeighborBuffer per chunk, then of whole pipeline runs.
+static auto bench_alloc(std::size_t max_nodes) -> void {
+    const auto k = 8ul;
+    ThreadPool pool;
+    for (auto num_points : { 100000ul, 1000000ul }) {
+        if (num_points > max_nodes) {
+            break;
+        }
+        std::mt19937 rng(42);
+        std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+        BenchCloud cloud;
+        cloud.xyz.resize(num_points * 3);
+        for (auto &v : cloud.xyz) {
+            v = uniform(rng);
+        }
+        BenchCloudIndex index(3, cloud, nanoflann::KDTreeSingleIndexAdaptorParams(10));
+        index.buildIndex();
+        const auto grain = pool.grain(num_points);
+
+        for (const auto per_query : { true, false }) {
+            std::vector<std::size_t> checksums(ThreadPool::num_chunks(num_points, grain), 0);
+            const auto allocations_begin = allocation_count.load();
+            const auto ms = time_ms([&] () {
+                pool.parallel_for(num_points, grain, [&] (std::size_t begin, std::size_t end) {
+                    auto checksum = 0ul;
+                    if (per_query) {
+                        for (auto i = begin; i < end; i++) {
+                            std::vector<std::size_t> indices(k + 1);
+                            std::vector<float> out_squared_dist(k + 1);
+                            const auto count = index.knnSearch(&cloud.xyz[i * 3], k + 1, &indices[0], &out_squared_dist[0]);
+                            checksum += indices[count - 1];
+                        }
+                    } else {
+                        NeighborBuffer neighbors(k + 1);
+                        for (auto i = begin; i < end; i++) {
+                            const auto count = neighbors.knn(index, &cloud.xyz[i * 3], k + 1);
+                            checksum += neighbors.indices()[count - 1];
+                        }
+                    }
+                    checksums[begin / grain] = checksum;
+                });
+            });
+            const auto allocations = allocation_count.load() - allocations_begin;
+            record("alloc",
+                   std::string(per_query ? "vector_per_query" : "neighbor_buffer") +
+                       " points=" + std::to_string(num_points),
+                   { { "allocations", allocations },
+                     { "allocations_per_query", (double) allocations / num_points },
+                     { "checksum", std::accumulate(checksums.begin(), checksums.end(), 0ul) },
+                     { "ms", ms } });
+        }
+
+        // Everything a run allocates besides its output
+        Hoppe hoppe;
+        hoppe.set_pointcloud(SyntheticCloud(SyntheticShape::sphere).sample(num_points, cloud_pool()));
+        const auto allocations_begin = allocation_count.load();
+        const auto report = hoppe.run();
+        const auto allocations = allocation_count.load() - allocations_begin;
+        std::remove("planecloud.ply");
+        record("alloc", "pipeline points=" + std::to_string(num_points),
+               { { "allocations", allocations },
+                 { "allocations_per_point", (double) allocations / num_points },
+                 { "success", report.success } });
+    }
+}
+
+/// Reconstructs one cloud with and without `Parameters::shared_knn` and
+/// records the time of every run and how the plane orientations differ.
+/// @param truth surface the cloud was sampled from, to count misoriented planes
+static auto bench_shared_knn_cloud(const std::string &name,
+                                   const std::vector<cv::Point3f> &points,
+                                   const SyntheticCloud *truth) -> void {
+    std::vector<Plane> planes[2];
+    for (const auto shared : { false, true }) {
+        Hoppe hoppe;
+        hoppe.parameters.shared_knn = shared;
+        hoppe.set_pointcloud(points);
+        const auto report = hoppe.run();
+        std::remove("planecloud.ply");
+        if (!report.success) {
+            fprintf(stderr, "Skipping %s: cannot reconstruct it\n", name.c_str());
+            return;
+        }
+        const auto stage_ms = [&] (const char *stage_name) {
+            const auto stage = report.find(stage_name);
+            return stage ? stage->wall_seconds * 1000.0 : 0.0;
+        };
+        auto total_ms = 0.0;
+        for (const auto &stage : report.stages) {
+            total_ms += stage.name == "load" ? 0.0 : stage.wall_seconds * 1000.0;
+        }
+        planes[shared] = hoppe.planes();
+        std::vector<std::pair<std::string, double> > metrics = {
+            { "estimate_planes_ms", stage_ms("estimate_planes") },
+            { "orientation_graph_ms", stage_ms("orientation_graph") },
+            { "orientation_ms", stage_ms("orientation_graph") + stage_ms("orientation_edges") +
+                stage_ms("orientation_mst") + stage_ms("orientation_traversal") },
+            { "bounds_ms", stage_ms("bounds") },
+            { "total_ms", total_ms },
+            { "graph_edges", report.find("orientation_edges")->items },
+            { "triangles", hoppe.mesh_indices().size() / 3 }
+        };
+        if (truth != nullptr) {
+            // Planes facing against the gradient of the true SDF. The global
+            // sign is a convention, so the smaller side counts as misoriented.
+            const auto h = 1e-3f;
+            auto inward = 0ul;
+            for (const auto &plane : planes[shared]) {
+                const auto &o = plane.origin;
+                const cv::Vec3f gradient(truth->sdf(o + cv::Point3f(h, 0, 0)) - truth->sdf(o - cv::Point3f(h, 0, 0)),
+                                         truth->sdf(o + cv::Point3f(0, h, 0)) - truth->sdf(o - cv::Point3f(0, h, 0)),
+                                         truth->sdf(o + cv::Point3f(0, 0, h)) - truth->sdf(o - cv::Point3f(0, 0, h)));
+                inward += plane.normal.dot(gradient) < 0.0f ? 1 : 0;
+            }
+            metrics.push_back({ "misoriented", std::min(inward, planes[shared].size() - inward) });
+        }
+        record("shared_knn", std::string(shared ? "shared " : "separate ") + name, metrics);
+    }
+
+    // Planes are fit to the same neighborhoods either way, only the graph
+    // that orients them differs
+    auto flipped = 0ul;
+    for (auto i = 0ul; i < planes[0].size(); i++) {
+        flipped += planes[0][i].normal.dot(planes[1][i].normal) < 0.0f ? 1 : 0;
+    }
+    record("shared_knn", "flips " + name, {
+        { "planes", planes[0].size() },
+        { "flipped", flipped },
+        { "flipped_ratio", (double) flipped / std::max((std::size_t) 1, planes[0].size()) }
+    });
+}
+
+static auto bench_shared_knn(std::size_t max_nodes) -> void {
+    for (const auto name : { "bunny", "torus", "res" }) {
+        Hoppe loader;
+        loader.load_pointcloud(std::string("assets/") + name + ".xyz");
+        bench_shared_knn_cloud(name, loader.points(), nullptr);
+    }
+    for (auto num_points : { 100000ul, 1000000ul }) {
+        if (num_points > max_nodes) {
+            break;
+        }
+        for (const auto shape : { SyntheticShape::sphere, SyntheticShape::torus, SyntheticShape::plane }) {
+            const SyntheticCloud cloud(shape, shape == SyntheticShape::plane ? 0.01f : 0.0f);
+            bench_shared_knn_cloud(std::string(SyntheticCloud::name(shape)) + std::to_string(num_points),
+                                   cloud.sample(num_points, cloud_pool()),
+                                   &cloud);
+        }
+    }
+}
+
+/// Runs `func` on this thread and returns its wall time in milliseconds
+/// and the cache misses it caused, -1 if they cannot be counted.
+template<typename F>
+static auto time_and_misses(F func) -> std::pair<double, double> {
+    const CacheMissCounter counter;
+    const auto misses_begin = counter.read_count();
+    const auto ms = time_ms(func);
+    const auto misses_end = counter.read_count();
+    return { ms, misses_begin < 0.0 ? -1.0 : misses_end - misses_begin };
+}
+
+/// Runs the kNN-heavy loops of the pipeline single threaded over a cloud
+/// in load order and in Morton order: a k nearest neighbor query per point,
+/// like plane estimation, and a nearest neighbor query per grid vertex in
+/// scan order, like SDF evaluation. Then runs the pipeline both ways.
+static auto bench_morton_cloud(const std::string &name, const std::vector<cv::Point3f> &points) -> void {
+    ThreadPool pool;
+    const auto order = morton_order(points, pool);
+    const auto k = 9ul;
+    for (const auto sorted : { false, true }) {
+        BenchCloud cloud;
+        cloud.xyz.resize(points.size() * 3);
+        for (auto i = 0ul; i < points.size(); i++) {
+            const auto &p = points[sorted ? order[i] : i];
+            cloud.xyz[i * 3] = p.x;
+            cloud.xyz[i * 3 + 1] = p.y;
+            cloud.xyz[i * 3 + 2] = p.z;
+        }
+        BenchCloudIndex index(3, cloud, nanoflann::KDTreeSingleIndexAdaptorParams(10));
+        index.buildIndex();
+
+        // How far in memory the neighbors of a point are from the point
+        auto gap_sum = 0.0;
+        const auto knn = time_and_misses([&] () {
+            NeighborBuffer neighbors(k);
+            for (auto i = 0ul; i < points.size(); i++) {
+                const auto count = neighbors.knn(index, &cloud.xyz[i * 3], k);
+                for (auto j = 0ul; j < count; j++) {
+                    const auto neighbor = neighbors.indices()[j];
+                    gap_sum += neighbor > i ? neighbor - i : i - neighbor;
+                }
+            }
+        });
+
+        cv::Point3f lo = points[0], hi = points[0];
+        for (const auto &p : points) {
+            lo = cv::Point3f(std::min(lo.x, p.x), std::min(lo.y, p.y), std::min(lo.z, p.z));
+            hi = cv::Point3f(std::max(hi.x, p.x), std::max(hi.y, p.y), std::max(hi.z, p.z));
+        }
+        const auto n = 64;
+        const auto step = (hi - lo) * (1.0f / (n - 1));
+        const auto nearest = time_and_misses([&] () {
+            NeighborBuffer neighbors(1);
+            for (auto z = 0; z < n; z++) {
+                for (auto y = 0; y < n; y++) {
+                    for (auto x = 0; x < n; x++) {
+                        const auto q = lo + cv::Point3f(x * step.x, y * step.y, z * step.z);
+                        neighbors.knn(index, &q.x, 1);
+                    }
+                }
+            }
+        });
+
+        // Without perf counters the misses are left out rather than
+        // recorded as a measurement
+        std::vector<std::pair<std::string, double> > metrics = {
+            { "knn_ms", knn.first },
+            { "mean_neighbor_gap", gap_sum / (points.size() * k) },
+            { "nearest_ms", nearest.first }
+        };
+        if (knn.second >= 0.0 && nearest.second >= 0.0) {
+            metrics.push_back({ "knn_cache_misses", knn.second });
+            metrics.push_back({ "nearest_cache_misses", nearest.second });
+        } else if (!sorted) {
+            fprintf(stderr, "No perf counters, cache misses of %s are not measured\n", name.c_str());
+        }
+        record("morton", std::string(sorted ? "morton " : "load ") + name, metrics);
+    }
+
+    for (const auto sorted : { false, true }) {
+        Hoppe hoppe;
+        hoppe.parameters.spatial_order = sorted;
+        hoppe.set_pointcloud(points);
+        const auto report = hoppe.run();
+        std::remove("planecloud.ply");
+        if (!report.success) {
+            fprintf(stderr, "Skipping %s: cannot reconstruct it\n", name.c_str());
+            return;
+        }
+        std::vector<std::pair<std::string, double> > metrics;
+        for (const auto stage_name : { "spatial_order", "estimate_planes", "orientation_graph", "sdf" }) {
+            const auto stage = report.find(stage_name);
+            metrics.push_back({ std::string(stage_name) + "_ms", stage ? stage->wall_seconds * 1000.0 : 0.0 });
+        }
+        metrics.push_back({ "triangles", hoppe.mesh_indices().size() / 3 });
+        record("morton", std::string(sorted ? "pipeline morton " : "pipeline load ") + name, metrics);
+    }
+}
+
+static auto bench_morton(std::size_t max_nodes) -> void {
+    {
+        Hoppe loader;
+        loader.load_pointcloud("assets/bunny.xyz");
+        bench_morton_cloud("bunny", loader.points());
+    }
+    for (auto num_points : { 100000ul, 1000000ul }) {
+        if (num_points > max_nodes) {
+            break;
+        }
+        const SyntheticCloud cloud(SyntheticShape::scene);
+        bench_morton_cloud("scene" + std::to_string(num_points), cloud.sample(num_points, cloud_pool()));
+    }
+}
+
+/// Prints a failed check and returns false.
+static auto check_failed(const char *check, const std::string &what) -> bool {
+    fprintf(stderr, "FAILED %s: %s\n", check, what.c_str());
+    return false;
+}
+
+/// Checks every row of the marching cubes table on its own and against the
+/// rows of the cells across each face:
+/// - no edge carries more than two triangles, no directed edge repeats;
+/// - no edge shared by two triangles of a row lies inside a cell face;
+/// - both cells sharing a face cut it along the same segments, in opposite
+///   directions, so the surface is closed and consistently oriented.
+static auto check_marching_tables() -> bool {
+    // Edge midpoints in half grid steps
+    const auto midpoint = [] (int edge) {
+        std::array<int, 3> p;
+        for (auto axis = 0; axis < 3; axis++) {
+            p[axis] = corner_offsets[edge_corners[edge][0]][axis] + corner_offsets[edge_corners[edge][1]][axis];
+        }
+        return p;
+    };
+    const auto on_face = [&] (int edge, int axis, int side) {
+        return midpoint(edge)[axis] == 2 * side;
+    };
+    const auto directed_edges = [] (int state) {
+        std::vector<std::pair<int, int> > edges;
+        const auto row = triangle_table[state];
+        for (auto i = 0; row[i] != -1; i += 3) {
+            for (auto j = 0; j < 3; j++) {
+                edges.push_back({ row[i + j], row[i + (j + 1) % 3] });
+            }
+        }
+        return edges;
+    };
+    const auto contains = [] (const std::vector<std::pair<int, int> > &edges, std::pair<int, int> edge) {
+        return std::count(edges.begin(), edges.end(), edge);
+    };
+    // Segments a state cuts into one of its faces, in half grid steps
+    // relative to the face's own cell
+    const auto face_segments = [&] (int state, int axis, int side) {
+        std::vector<std::pair<std::array<int, 3>, std::array<int, 3> > > segments;
+        for (const auto &edge : directed_edges(state)) {
+            if (on_face(edge.first, axis, side) && on_face(edge.second, axis, side)) {
+                segments.push_back({ midpoint(edge.first), midpoint(edge.second) });
+            }
+        }
+        return segments;
+    };
+
+    auto ok = true;
+    for (auto state = 0; state < 256; state++) {
+        const auto edges = directed_edges(state);
+        for (const auto &edge : edges) {
+            const auto uses = contains(edges, edge) + contains(edges, { edge.second, edge.first });
+            if (contains(edges, edge) > 1 || uses > 2) {
+                ok = check_failed("marching_tables", "state " + std::to_string(state) + " overuses edge " +
+                                  std::to_string(edge.first) + "-" + std::to_string(edge.second));
+            }
+            for (auto axis = 0; axis < 3; axis++) {
+                for (auto side = 0; side < 2; side++) {
+                    if (uses == 2 && on_face(edge.first, axis, side) && on_face(edge.second, axis, side)) {
+                        ok = check_failed("marching_tables", "state " + std::to_string(state) + " has diagonal " +
+                                          std::to_string(edge.first) + "-" + std::to_string(edge.second) +
+                                          " inside a face");
+                    }
+                }
+            }
+        }
+
+        // Every neighbor whose corners on the shared face match ours
+        for (auto axis = 0; axis < 3; axis++) {
+            auto upper = face_segments(state, axis, 1);
+            for (auto &segment : upper) {
+                segment.first[axis] -= 2;
+                segment.second[axis] -= 2;
+                std::swap(segment.first, segment.second);
+            }
+            std::sort(upper.begin(), upper.end());
+            for (auto neighbor = 0; neighbor < 256; neighbor++) {
+                auto matches = true;
+                for (auto corner = 0; corner < 8; corner++) {
+                    if (corner_offsets[corner][axis] == 1) {
+                        continue;
+                    }
+                    // Corner of the neighbor's lower face and ours on the upper face
+                    auto mirrored = 0;
+                    while (mirrored < 8) {
+                        auto same = corner_offsets[mirrored][axis] == 1;
+                        for (auto other = 0; other < 3; other++) {
+                            same = same && (other == axis || corner_offsets[mirrored][other] == corner_offsets[corner][other]);
+                        }
+                        if (same) {
+                            break;
+                        }
+                        mirrored++;
+                    }
+                    matches = matches && ((neighbor >> corner) & 1) == ((state >> mirrored) & 1);
+                }
+                if (!matches) {
+                    continue;
+                }
+                auto lower = face_segments(neighbor, axis, 0);
+                std::sort(lower.begin(), lower.end());
+                if (lower != upper) {
+                    ok = check_failed("marching_tables", "states " + std::to_string(state) + " and " +
+                                      std::to_string(neighbor) + " disagree on their face along axis " +
+                                      std::to_string(axis));
+                }
+            }
+        }
+    }
+    return ok;
+}
+
+/// Compares every row of the marching cubes table with the surface patch its
+/// corner signs call for, built here without the table: on every cell face,
+/// a segment between the two edges that cross the surface, or on faces with
+/// set corners on a diagonal, one segment cutting off each set corner. The
+/// segments run so that the surface faces the set corners. The rows must
+/// use exactly the crossing edges and have these segments as their boundary;
+/// how they split the patch into triangles is up to them.
+static auto check_marching_reference() -> bool {
+    // Positions in half grid steps
+    const auto corner_position = [] (int corner) {
+        return cv::Point3i(2 * corner_offsets[corner][0], 2 * corner_offsets[corner][1], 2 * corner_offsets[corner][2]);
+    };
+    const auto edge_position = [&] (int edge) {
+        const auto sum = corner_position(edge_corners[edge][0]) + corner_position(edge_corners[edge][1]);
+        return cv::Point3i(sum.x / 2, sum.y / 2, sum.z / 2);
+    };
+    const auto touches = [] (int edge, int corner) {
+        return edge_corners[edge][0] == corner || edge_corners[edge][1] == corner;
+    };
+
+    auto ok = true;
+    for (auto state = 0; state < 256; state++) {
+        const auto set = [&] (int corner) {
+            return ((state >> corner) & 1) != 0;
+        };
+        const auto crosses = [&] (int edge) {
+            return set(edge_corners[edge][0]) != set(edge_corners[edge][1]);
+        };
+
+        std::vector<std::pair<int, int> > expected;
+        for (auto axis = 0; axis < 3; axis++) {
+            for (auto side = 0; side < 2; side++) {
+                const cv::Point3i outward(axis == 0 ? 2 * side - 1 : 0,
+                                          axis == 1 ? 2 * side - 1 : 0,
+                                          axis == 2 ? 2 * side - 1 : 0);
+                std::vector<int> face_corners, face_edges;
+                for (auto corner = 0; corner < 8; corner++) {
+                    if (corner_offsets[corner][axis] == side) {
+                        face_corners.push_back(corner);
+                    }
+                }
+                for (auto edge = 0; edge < 12; edge++) {
+                    if (corner_offsets[edge_corners[edge][0]][axis] == side &&
+                        corner_offsets[edge_corners[edge][1]][axis] == side && crosses(edge)) {
+                        face_edges.push_back(edge);
+                    }
+                }
+                // Directs p -> q so that the cut off set corner lies on the
+                // side the surface faces
+                const auto add_segment = [&] (int p, int q, int corner) {
+                    const auto along = edge_position(q) - edge_position(p);
+                    const auto to_corner = corner_position(corner) - edge_position(p);
+                    if (along.cross(to_corner).dot(outward) < 0) {
+                        std::swap(p, q);
+                    }
+                    expected.push_back({ p, q });
+                };
+                if (face_edges.size() == 2) {
+                    // Every set corner of the face is on the facing side
+                    for (const auto corner : face_corners) {
+                        if (set(corner)) {
+                            add_segment(face_edges[0], face_edges[1], corner);
+                            break;
+                        }
+                    }
+                } else if (face_edges.size() == 4) {
+                    for (const auto corner : face_corners) {
+                        if (!set(corner)) {
+                            continue;
+                        }
+                        std::vector<int> cut;
+                        for (const auto edge : face_edges) {
+                            if (touches(edge, corner)) {
+                                cut.push_back(edge);
+                            }
+                        }
+                        add_segment(cut[0], cut[1], corner);
+                    }
+                }
+            }
+        }
+
+        std::vector<std::pair<int, int> > edges, boundary;
+        std::vector<int> used(12, 0);
+        const auto row = triangle_table[state];
+        for (auto i = 0; row[i] != -1; i += 3) {
+            for (auto j = 0; j < 3; j++) {
+                edges.push_back({ row[i + j], row[i + (j + 1) % 3] });
+                used[row[i + j]] = 1;
+            }
+        }
+        for (const auto &edge : edges) {
+            if (std::find(edges.begin(), edges.end(), std::make_pair(edge.second, edge.first)) == edges.end()) {
+                boundary.push_back(edge);
+            }
+        }
+        std::sort(expected.begin(), expected.end());
+        std::sort(boundary.begin(), boundary.end());
+        auto same_edges = true;
+        for (auto edge = 0; edge < 12; edge++) {
+            same_edges = same_edges && (used[edge] != 0) == crosses(edge);
+        }
+        if (!same_edges || boundary != expected) {
+            ok = check_failed("marching_reference", "state " + std::to_string(state) +
+                              " does not match the patch of its corner signs");
+        }
+    }
+    record("check", "marching_reference", { { "passed", ok } });
+    return ok;
+}
+
+/// Counts edges of a welded mesh shared by more than two triangles and
+/// directed edges used twice, both zero on an oriented 2-manifold.
+static auto count_non_manifold(const std::vector<std::uint32_t> &indices) -> std::pair<std::size_t, std::size_t> {
+    std::vector<std::pair<std::uint64_t, int> > edges;
+    edges.reserve(indices.size());
+    for (auto i = 0ul; i + 2 < indices.size(); i += 3) {
+        for (auto j = 0; j < 3; j++) {
+            const auto a = (std::uint64_t) indices[i + j], b = (std::uint64_t) indices[i + (j + 1) % 3];
+            // Direction in the low bit, so both directions of an edge sort together
+            edges.push_back({ (std::min(a, b) << 32 | std::max(a, b)), a < b ? 0 : 1 });
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    auto crowded = 0ul, repeated = 0ul;
+    for (auto begin = 0ul; begin < edges.size();) {
+        auto end = begin;
+        while (end < edges.size() && edges[end].first == edges[begin].first) {
+            end++;
+        }
+        crowded += end - begin > 2 ? 1 : 0;
+        for (auto i = begin + 1; i < end; i++) {
+            repeated += edges[i] == edges[i - 1] ? 1 : 0;
+        }
+        begin = end;
+    }
+    return { crowded, repeated };
+}
+
+/// Marches a random field, which hits every cell state and every ambiguous
+/// face, in all grid modes and checks that the meshes are 2-manifolds.
+static auto check_marching_mesh() -> bool {
+    const auto n = 24;
+    const auto resolution = 1.0f;
+    const cv::Point3f offset(0.0f, 0.0f, 0.0f);
+    const auto field = [] (cv::Point3f p) -> std::optional<float> {
+        // Hash of the grid vertex, so every mode sees the same values
+        auto h = (std::uint32_t) lroundf(p.x) * 73856093u ^ (std::uint32_t) lroundf(p.y) * 19349663u ^
+            (std::uint32_t) lroundf(p.z) * 83492791u;
+        h ^= h >> 13;
+        h *= 0x5bd1e995u;
+        h ^= h >> 15;
+        return (h & 0xffff) / 32768.0f - 1.0f;
+    };
+    std::vector<cv::Point3f> centers;
+    for (auto z = 0; z < n; z++) {
+        for (auto y = 0; y < n; y++) {
+            for (auto x = 0; x < n; x++) {
+                centers.push_back(cv::Point3f(x, y, z));
+            }
+        }
+    }
+    const std::pair<GridMode, const char *> modes[] = {
+        { GridMode::dense, "dense" },
+        { GridMode::sparse, "sparse" },
+        { GridMode::streaming, "streaming" }
+    };
+    auto ok = true;
+    for (const auto &mode : modes) {
+        CubeMarcher marcher(cv::Vec3i(n, n, n), resolution, mode.first);
+        marcher.set_band(centers, 0.5f * resolution, offset);
+        std::vector<std::uint32_t> indices;
+        marcher.march(field, offset, [&] (const std::vector<cv::Point3f> &, const std::vector<std::uint32_t> &chunk) {
+            indices.insert(indices.end(), chunk.begin(), chunk.end());
+        });
+        const auto counts = count_non_manifold(indices);
+        record("check", std::string("marching_mesh ") + mode.second, {
+            { "triangles", indices.size() / 3 },
+            { "crowded_edges", counts.first },
+            { "repeated_half_edges", counts.second }
+        });
+        if (indices.empty() || counts.first != 0 || counts.second != 0) {
+            ok = check_failed("marching_mesh", std::string(mode.second) + " grid is not a 2-manifold");
+        }
+    }
+    return ok;
+}
+
+/// Compares the batched Jacobi solver with the cv::eigen reference on
+/// covariances of known eigenvalues: random ones and degenerate ones (zero,
+/// rank 1 and 2, repeated and nearly zero eigenvalues), both rotated at
+/// random and axis aligned. Where the smallest eigenvalue is repeated the
+/// normal is any vector of its eigenspace, so the normals are then only
+/// checked through their Rayleigh quotient.
+static auto check_normals() -> bool {
+    const auto tolerance = 1e-4f;
+    // Eigenvalues, smallest last; empty for random ones
+    const std::vector<std::vector<float> > spectra = {
+        {}, { 0.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 1.0f, 0.5f, 0.0f },
+        { 1.0f, 1.0f, 1.0f }, { 1.0f, 1.0f, 0.2f }, { 1.0f, 0.3f, 0.3f },
+        { 1.0f, 1.0f, 1e-4f }, { 1.0f, 0.9f, 1e-6f }, { 1e-12f, 5e-13f, 1e-13f }
+    };
+    const auto per_spectrum = 1000;
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    std::normal_distribution<float> normal;
+
+    std::vector<cv::Matx33f> covariances;
+    std::vector<cv::Vec3f> eigenvalues;
+    for (const auto &spectrum : spectra) {
+        for (auto i = 0; i < per_spectrum; i++) {
+            cv::Vec3f lambda;
+            for (auto j = 0; j < 3; j++) {
+                lambda(j) = spectrum.empty() ? uniform(rng) : spectrum[j];
+            }
+            std::sort(lambda.val, lambda.val + 3, std::greater<float>());
+            // Random rotation from a unit quaternion, identity for the first few
+            float q[4] = { 1.0f, 0.0f, 0.0f, 0.0f };
+            if (i >= 10) {
+                auto length = 0.0f;
+                for (auto &c : q) {
+                    c = normal(rng);
+                    length += c * c;
+                }
+                for (auto &c : q) {
+                    c /= std::sqrt(length);
+                }
+            }
+            const float r[3][3] = {
+                { 1 - 2 * (q[2] * q[2] + q[3] * q[3]), 2 * (q[1] * q[2] - q[0] * q[3]), 2 * (q[1] * q[3] + q[0] * q[2]) },
+                { 2 * (q[1] * q[2] + q[0] * q[3]), 1 - 2 * (q[1] * q[1] + q[3] * q[3]), 2 * (q[2] * q[3] - q[0] * q[1]) },
+                { 2 * (q[1] * q[3] - q[0] * q[2]), 2 * (q[2] * q[3] + q[0] * q[1]), 1 - 2 * (q[1] * q[1] + q[2] * q[2]) }
+            };
+            cv::Matx33f covariance;
+            for (auto row = 0; row < 3; row++) {
+                for (auto col = 0; col < 3; col++) {
+                    auto sum = 0.0f;
+                    for (auto k = 0; k < 3; k++) {
+                        sum += r[row][k] * lambda(k) * r[col][k];
+                    }
+                    covariance(row, col) = sum;
+                }
+            }
+            covariances.push_back(covariance);
+            eigenvalues.push_back(lambda);
+        }
+    }
+
+    std::vector<NormalEstimate> estimates(covariances.size());
+    solve_normals(covariances.data(), covariances.size(), estimates.data());
+
+    // Rayleigh quotient over the trace, the smallest eigenvalue for a true normal
+    const auto rayleigh = [] (const cv::Matx33f &m, const cv::Vec3f &n, float trace) {
+        auto sum = 0.0f;
+        for (auto row = 0; row < 3; row++) {
+            for (auto col = 0; col < 3; col++) {
+                sum += n(row) * m(row, col) * n(col);
+            }
+        }
+        return trace > 0.0f ? sum / trace : sum;
+    };
+    auto failures = 0ul, compared_normals = 0ul;
+    auto worst_dot = 1.0f, worst_curvature = 0.0f;
+    for (auto i = 0ul; i < covariances.size(); i++) {
+        const auto reference = solve_normal_reference(covariances[i]);
+        const auto &lambda = eigenvalues[i];
+        const auto trace = lambda(0) + lambda(1) + lambda(2);
+        const auto curvature = trace > 0.0f ? lambda(2) / trace : 0.0f;
+        auto ok = true;
+        for (const auto &estimate : { estimates[i], reference }) {
+            ok = ok && std::fabs(cv::norm(estimate.normal) - 1.0) < tolerance;
+            ok = ok && std::fabs(rayleigh(covariances[i], estimate.normal, trace) - curvature) < tolerance;
+        }
+        const auto curvature_error = std::fabs(estimates[i].curvature - reference.curvature);
+        worst_curvature = std::max(worst_curvature, curvature_error);
+        ok = ok && curvature_error < tolerance && std::fabs(reference.curvature - curvature) < tolerance;
+        // The normal is unique when the smallest eigenvalue is
+        if (trace > 0.0f && (lambda(1) - lambda(2)) / trace > 1e-2f) {
+            const auto dot = std::fabs(estimates[i].normal.dot(reference.normal));
+            worst_dot = std::min(worst_dot, dot);
+            ok = ok && dot > 1.0f - tolerance;
+            compared_normals++;
+        }
+        if (!ok) {
+            check_failed("normals", "covariance " + std::to_string(i) + " with eigenvalues " +
+                         std::to_string(lambda(0)) + ", " + std::to_string(lambda(1)) + ", " +
+                         std::to_string(lambda(2)));
+            failures++;
+        }
+    }
+    record("check", "normals", {
+        { "covariances", covariances.size() },
+        { "compared_normals", compared_normals },
+        { "worst_abs_dot", worst_dot },
+        { "worst_curvature_error", worst_curvature },
+        { "failures", failures }
+    });
+    return failures == 0;
+}
+
+/// The allocation counter must see every heap allocation the benchmarks
+/// compare, including the over-aligned ones of the marching grids.
+static auto check_allocation_counter() -> bool {
+    struct alignas(64) CacheLine {
+        float values[16];
+    };
+    auto allocations_begin = allocation_count.load();
+    FlatGrid<float> grid;
+    grid.resize(cv::Vec3i(8, 8, 8));
+    const auto grid_allocations = allocation_count.load() - allocations_begin;
+    allocations_begin = allocation_count.load();
+    auto *lines = new (std::nothrow) CacheLine[4];
+    const auto array_allocations = allocation_count.load() - allocations_begin;
+    const auto passed = grid_allocations == 1 && array_allocations == 1 &&
+        (std::uintptr_t) grid.data.data() % 64 == 0 && (std::uintptr_t) lines % 64 == 0;
+    delete[] lines;
+    record("check", "allocation_counter", {
+        { "grid_allocations", grid_allocations },
+        { "array_allocations", array_allocations },
+        { "passed", passed }
+    });
+    return passed || check_failed("allocation_counter", "aligned allocations are not counted");
+}
+
+static auto run_checks() -> bool {
+    auto ok = true;
+    const auto tables_ok = check_marching_tables();
+    record("check", "marching_tables", { { "passed", tables_ok } });
+    ok = tables_ok && ok;
+    ok = check_marching_reference() && ok;
+    ok = check_marching_mesh() && ok;
+    ok = check_normals() && ok;
+    ok = check_allocation_counter() && ok;
+    return ok;
+}
+
+int main(int argc, const char * argv[]) {
+    const std::string only = argc > 1 ? argv[1] : "";
+    const auto max_nodes = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 10000000ul;
+    const std::string json_path = argc > 3 ? argv[3] : "";
+    const auto selected = [&] (const char *name) {
+        return only.empty() || only == "all" || only == name;
+    };
+    if (selected("traverse_dfs")) {
+        bench_traverse_dfs(max_nodes);
+    }
+    if (selected("adjacency")) {
+        bench_adjacency(max_nodes);
+    }
+    if (selected("mst")) {
+        bench_mst(max_nodes);
+    }
+    if (selected("march")) {
+        bench_march(max_nodes);
+    }
+    if (selected("assets")) {
+        bench_assets();
+    }
+    if (selected("synthetic")) {
+        bench_synthetic(max_nodes);
+    }
+    if (selected("sdf")) {
+        bench_sdf(max_nodes);
+    }
+    if (selected("xyz")) {
+        bench_xyz(max_nodes);
+    }
+    if (selected("alloc")) {
+        bench_alloc(max_nodes);
+    }
+    if (selected("shared_knn")) {
+        bench_shared_knn(max_nodes);
+    }
+    if (selected("morton")) {
+        bench_morton(max_nodes);
+    }
+    auto checks_passed = true;
+    if (selected("check")) {
+        checks_passed = run_checks();
+    }
+    if (!json_path.empty() && !write_json(json_path)) {
+        return 1;
+    }
+    if (!checks_passed) {
+        return 1;
+    }
+    return 0;
+}
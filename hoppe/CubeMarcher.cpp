@@ -6,1752 +6,905 @@
 //
 
 #include "CubeMarcher.hpp"
-#include <thread>
 #include <vector>
 #include <fstream>
 #include <mutex>
 #include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <array>
+#include "MarchingCubesTables.hpp"
+
+
+/// A cell edge, named by the offset of its lower corner within the cell and its axis.
+struct EdgeSlot {
+    int dx, dy, dz, axis;
+};
+
+static auto make_edge_slots() -> std::array<EdgeSlot, 12> {
+    std::array<EdgeSlot, 12> slots;
+    for (auto e = 0; e < 12; e++) {
+        const auto *c0 = corner_offsets[edge_corners[e][0]];
+        const auto *c1 = corner_offsets[edge_corners[e][1]];
+        slots[e] = { std::min(c0[0], c1[0]),
+                     std::min(c0[1], c1[1]),
+                     std::min(c0[2], c1[2]),
+                     c0[0] != c1[0] ? 0 : c0[1] != c1[1] ? 1 : 2 };
+    }
+    return slots;
+}
 
-#define FACE(a, b, c) \
-faces.push_back(Triangle { edge_offset[a], \
-                           edge_offset[b], \
-                           edge_offset[c] } + pos)
-
-
-auto CubeMarcher::init(cv::Vec3i size, float resolution) -> void {
-    cell_mat.resize(size(2));
-    for (auto i = 0; i < cell_mat.size(); i++) {
-        cell_mat[i].resize(size(1));
-        for (auto j = 0; j < cell_mat[i].size(); j++) {
-            cell_mat[i][j].resize(size(0));
+static const auto edge_slots = make_edge_slots();
+
+static constexpr auto no_vertex = std::numeric_limits<std::uint32_t>::max();
+
+/// Numbers the crossing x and y edges of one vertex plane from `next_id` on.
+/// @param plane SDF values of the plane, x varying fastest
+/// @param ids ids of the x edges followed by ids of the y edges
+/// @param emit called as emit(x, y, axis, id) for every crossing edge
+template<typename Emit>
+static auto number_plane_edges(const float *plane, int nx, int ny,
+                               std::uint32_t *ids, std::uint32_t &next_id, Emit &&emit) -> void {
+    const auto plane_size = (std::size_t) nx * ny;
+    for (auto y = 0; y < ny; y++) {
+        for (auto x = 0; x < nx; x++) {
+            const auto v = (std::size_t) y * nx + x;
+            const auto inside = plane[v] < 0;
+            ids[v] = no_vertex;
+            ids[plane_size + v] = no_vertex;
+            if (x < nx - 1 && (plane[v + 1] < 0) != inside) {
+                ids[v] = next_id;
+                emit(x, y, 0, next_id++);
+            }
+            if (y < ny - 1 && (plane[v + nx] < 0) != inside) {
+                ids[plane_size + v] = next_id;
+                emit(x, y, 1, next_id++);
+            }
         }
     }
-    this->size = size;
-    this->resolution = resolution;
 }
 
-auto CubeMarcher::march(std::function<std::optional<float> (cv::Point3f)> sdf,
-                        cv::Point3f offset) -> void {
-    const auto volume = size(0) * size(1) * size(2);
-    const auto num_threads = std::min(std::thread::hardware_concurrency(),
-                                      (unsigned int) volume);
-    const auto marches_per_thread = volume / num_threads;
-    std::vector<std::thread> threads;
-    HOPPE_LOG("Marching %d times with %d marches per thread", volume, marches_per_thread);
-    
-    // Define the offset of 8 corners of cube
-    cv::Point3f sample_offset[8] = {
-        { 0.0f, 0.0f, 0.0f },
-        { resolution, 0.0f, 0.0f },
-        { resolution, resolution, 0.0f },
-        { 0.0f, resolution, 0.0f },
-        { 0.0f, 0.0f, resolution },
-        { resolution, 0.0f, resolution },
-        { resolution, resolution, resolution },
-        { 0.0f, resolution, resolution }
-    };
-    cv::Point3i lut_offset[8] = {
-        { 0, 0, 0 },
-        { 1, 0, 0 },
-        { 1, 1, 0 },
-        { 0, 1, 0 },
-        { 0, 0, 1 },
-        { 1, 0, 1 },
-        { 1, 1, 1 },
-        { 0, 1, 1 },
-    };
-    const auto half_resolution = resolution / 2.0f;
-    cv::Point3f edge_offset[12] = {
-        { half_resolution, 0.0f, 0.0f },
-        { resolution, half_resolution, 0.0f },
-        { half_resolution, resolution, 0.0f },
-        { 0.0f, half_resolution, 0.0f },
-        { half_resolution, 0.0f, resolution },
-        { resolution, half_resolution, resolution },
-        { half_resolution, resolution, resolution },
-        { 0.0f, half_resolution, resolution },
-        { 0.0f, 0.0f, half_resolution },
-        { resolution, 0.0f, half_resolution },
-        { resolution, resolution, half_resolution },
-        { 0.0f, resolution, half_resolution }
-    };
-    std::vector<std::vector<std::vector<std::optional<float> > > > lut;
-    lut.resize(size(2));
-    for (auto z = 0; z < lut.size(); z++) {
-        lut[z].resize(size(1));
-        for (auto y = 0; y < lut[z].size(); y++) {
-            lut[z][y].resize(size(0));
+/// Numbers the crossing z edges between two vertex planes from `next_id` on.
+template<typename Emit>
+static auto number_z_edges(const float *lower, const float *upper, int nx, int ny,
+                           std::uint32_t *ids, std::uint32_t &next_id, Emit &&emit) -> void {
+    for (auto y = 0; y < ny; y++) {
+        for (auto x = 0; x < nx; x++) {
+            const auto v = (std::size_t) y * nx + x;
+            ids[v] = no_vertex;
+            if ((lower[v] < 0) != (upper[v] < 0)) {
+                ids[v] = next_id;
+                emit(x, y, 2, next_id++);
+            }
         }
     }
-    
-    std::mutex lut_mutex;
-    std::mutex face_mutex;
-    auto num_faces = 0;
-    faces.clear();
-    
-    auto maximum = offset + cv::Point3f(size(0) * resolution,
-                                        size(1) * resolution,
-                                        size(2) * resolution);
-    HOPPE_LOG("Actual maximum: %f %f %f", maximum.x, maximum.y, maximum.z);
-
-    for (auto thread_id = 0; thread_id < num_threads; thread_id++) {
-        const auto march = [&, thread_id] () {
-            for (auto j = 0; j < marches_per_thread; j++) {
-                const auto index = (thread_id * marches_per_thread) + j;
-                const auto x = index % size(0);
-                const auto y = (index / size(0)) % size(1);
-                const auto z = (index / size(0) / size(1));
-                if (x == size(0) - 1 || y == size(1) - 1 || z == size(2) - 1) {
-                    continue;
-                }
-                const cv::Point3f pos(offset + cv::Point3f(x * resolution, y * resolution, z * resolution));
-                auto &cell = cell_mat[z][y][x];
-                cell.state = 0;
-                for (auto i = 0; i < 8; i++) {
-                    auto dist = 1.0f;
-                    auto x_neighbor = x + lut_offset[i].x;
-                    auto y_neighbor = y + lut_offset[i].y;
-                    auto z_neighbor = z + lut_offset[i].z;
-                    if (!lut[z_neighbor][y_neighbor][x_neighbor].has_value()) {
-                        auto dist_sdf = sdf(pos + sample_offset[i]);
-                        if (dist_sdf.has_value()) {
-                            dist = dist_sdf.value();
-                        }
-                        lut_mutex.lock();
-                        lut[z_neighbor][y_neighbor][x_neighbor] = dist;
-                        lut_mutex.unlock();
-                    } else {
-                        dist = lut[z_neighbor][y_neighbor][x_neighbor].value();
-                    }
-                    
-                    cell.values[i] = dist;
-                    if (cell.values[i] < 0) {
-                        cell.state += pow(2, i);
-                    }
-                }
-                cell.state = 255 - cell.state;
-                if (cell.state == 0 || cell.state == 255) {
-                    continue;
-                }
-                num_faces++;
-                // TODO: reconstruct face...
-                face_mutex.lock();
-                switch (cell.state) {
-                    case 0:
-                    case 255:
-                        break;
-                        
-                    case 1:
-                        FACE(3, 0, 8);
-                        break;
-
-                    case 2:
-                        FACE(1, 9, 0);
-                        break;
-
-                    case 3:
-                        FACE(3, 9, 8);
-                        FACE(3, 1, 9);
-                        break;
-
-                    case 4:
-                        FACE(10, 1, 2);
-                        break;
-
-                    case 5:
-                        FACE(10, 1, 2);
-                        FACE(0, 8, 3);
-                        break;
-
-                    case 6:
-                        FACE(10, 0, 2);
-                        FACE(10, 9, 0);
-                        break;
-
-                    case 7:
-                        FACE(2, 8, 3);
-                        FACE(2, 10, 8);
-                        FACE(10, 9, 8);
-                        break;
-
-                    case 8:
-                        FACE(11, 2, 3);
-                        break;
-
-                    case 9:
-                        FACE(2, 8, 11);
-                        FACE(2, 0, 8);
-                        break;
-
-                    case 10:
-                        FACE(11, 2, 3);
-                        FACE(1, 9, 0);
-                        break;
-
-                    case 11:
-                        FACE(1, 11, 2);
-                        FACE(1, 9, 11);
-                        FACE(9, 8, 11);
-                        break;
-
-                    case 12:
-                        FACE(11, 1, 3);
-                        FACE(11, 10, 1);
-                        break;
-
-                    case 13:
-                        FACE(0, 10, 1);
-                        FACE(0, 8, 10);
-                        FACE(8, 11, 10);
-                        break;
-
-                    case 14:
-                        FACE(3, 9, 0);
-                        FACE(3, 11, 9);
-                        FACE(11, 10, 9);
-                        break;
-
-                    case 15:
-                        FACE(9, 8, 10);
-                        FACE(10, 8, 11);
-                        break;
-
-                    case 16:
-                        FACE(8, 4, 7);
-                        break;
-
-                    case 17:
-                        FACE(0, 7, 3);
-                        FACE(0, 4, 7);
-                        break;
-
-                    case 18:
-                        FACE(1, 9, 0);
-                        FACE(4, 7, 8);
-                        break;
-
-                    case 19:
-                        FACE(4, 1, 9);
-                        FACE(4, 7, 1);
-                        FACE(7, 3, 1);
-                        break;
-
-                    case 20:
-                        FACE(8, 4, 7);
-                        FACE(10, 1, 2);
-                        break;
-
-                    case 21:
-                        FACE(7, 0, 4);
-                        FACE(7, 3, 0);
-                        FACE(2, 10, 1);
-                        break;
-
-                    case 22:
-                        FACE(10, 0, 2);
-                        FACE(10, 9, 0);
-                        FACE(4, 7, 8);
-                        break;
-
-                    case 23:
-                        FACE(9, 4, 10);
-                        FACE(10, 4, 7);
-                        FACE(10, 7, 2);
-                        FACE(2, 7, 3);
-                        break;
-
-                    case 24:
-                        FACE(4, 7, 8);
-                        FACE(11, 2, 3);
-                        break;
-
-                    case 25:
-                        FACE(11, 4, 7);
-                        FACE(11, 2, 4);
-                        FACE(2, 0, 4);
-                        break;
-
-                    case 26:
-                        FACE(9, 0, 1);
-                        FACE(3, 11, 2);
-                        FACE(6, 8, 4);
-                        break;
-
-                    case 27:
-                        FACE(2, 1, 11);
-                        FACE(11, 1, 9);
-                        FACE(11, 9, 7);
-                        FACE(7, 9, 4);
-                        break;
-
-                    case 28:
-                        FACE(1, 11, 10);
-                        FACE(1, 3, 11);
-                        FACE(8, 4, 7);
-                        break;
-
-                    case 29:
-                        FACE(10, 7, 11);
-                        FACE(10, 4, 7);
-                        FACE(10, 1, 4);
-                        FACE(1, 0, 4);
-                        break;
-
-                    case 30:
-                        FACE(3, 9, 0);
-                        FACE(3, 11, 9);
-                        FACE(11, 10, 9);
-                        FACE(0, 7, 8);
-                        break;
-
-                    case 31:
-                        FACE(11, 10, 9);
-                        FACE(11, 9, 4);
-                        FACE(7, 11, 4);
-                        break;
-
-                    case 32:
-                        FACE(9, 5, 4);
-                        break;
-
-                    case 33:
-                        FACE(3, 0, 8);
-                        FACE(9, 5, 4);
-                        break;
-
-                    case 34:
-                        FACE(1, 4, 0);
-                        FACE(1, 5, 4);
-                        break;
-
-                    case 35:
-                        FACE(8, 5, 4);
-                        FACE(8, 3, 5);
-                        FACE(3, 1, 5);
-                        break;
-
-                    case 36:
-                        FACE(4, 9, 5);
-                        FACE(1, 2, 10);
-                        break;
-
-                    case 37:
-                        FACE(3, 0, 8);
-                        FACE(9, 5, 4);
-                        FACE(6, 1, 2);
-                        break;
-
-                    case 38:
-                        FACE(5, 2, 10);
-                        FACE(5, 4, 2);
-                        FACE(4, 0, 2);
-                        break;
-
-                    case 39:
-                        FACE(4, 8, 5);
-                        FACE(5, 8, 3);
-                        FACE(5, 3, 10);
-                        FACE(10, 3, 2);
-                        break;
-
-                    case 40:
-                        FACE(11, 2, 3);
-                        FACE(9, 5, 4);
-                        break;
-
-                    case 41:
-                        FACE(2, 8, 11);
-                        FACE(2, 0, 8);
-                        FACE(9, 5, 4);
-                        break;
-
-                    case 42:
-                        FACE(4, 1, 5);
-                        FACE(4, 0, 1);
-                        FACE(3, 11, 2);
-                        break;
-
-                    case 43:
-                        FACE(5, 2, 1);
-                        FACE(5, 11, 2);
-                        FACE(5, 4, 11);
-                        FACE(4, 8, 11);
-                        break;
-
-                    case 44:
-                        FACE(11, 1, 3);
-                        FACE(11, 10, 1);
-                        FACE(5, 4, 9);
-                        break;
-
-                    case 45:
-                        FACE(0, 10, 1);
-                        FACE(0, 8, 10);
-                        FACE(8, 11, 10);
-                        FACE(1, 4, 9);
-                        break;
-
-                    case 46:
-                        FACE(0, 3, 4);
-                        FACE(4, 3, 11);
-                        FACE(4, 11, 5);
-                        FACE(5, 11, 10);
-                        break;
-
-                    case 47:
-                        FACE(8, 11, 10);
-                        FACE(8, 10, 5);
-                        FACE(4, 8, 5);
-                        break;
-
-                    case 48:
-                        FACE(8, 5, 7);
-                        FACE(8, 9, 5);
-                        break;
-
-                    case 49:
-                        FACE(9, 3, 0);
-                        FACE(9, 5, 3);
-                        FACE(5, 7, 3);
-                        break;
-
-                    case 50:
-                        FACE(0, 7, 8);
-                        FACE(0, 1, 7);
-                        FACE(1, 5, 7);
-                        break;
-
-                    case 51:
-                        FACE(5, 7, 1);
-                        FACE(1, 7, 3);
-                        break;
-
-                    case 52:
-                        FACE(8, 5, 7);
-                        FACE(8, 9, 5);
-                        FACE(1, 2, 10);
-                        break;
-
-                    case 53:
-                        FACE(9, 3, 0);
-                        FACE(9, 5, 3);
-                        FACE(5, 7, 3);
-                        FACE(0, 10, 1);
-                        break;
-
-                    case 54:
-                        FACE(7, 10, 5);
-                        FACE(7, 2, 10);
-                        FACE(7, 8, 2);
-                        FACE(8, 0, 2);
-                        break;
-
-                    case 55:
-                        FACE(5, 7, 3);
-                        FACE(5, 3, 2);
-                        FACE(10, 5, 2);
-                        break;
-
-                    case 56:
-                        FACE(5, 8, 9);
-                        FACE(5, 7, 8);
-                        FACE(11, 2, 3);
-                        break;
-
-                    case 57:
-                        FACE(0, 9, 2);
-                        FACE(2, 9, 5);
-                        FACE(2, 5, 11);
-                        FACE(11, 5, 7);
-                        break;
-
-                    case 58:
-                        FACE(0, 7, 8);
-                        FACE(0, 1, 7);
-                        FACE(1, 5, 7);
-                        FACE(8, 2, 3);
-                        break;
-
-                    case 59:
-                        FACE(1, 5, 7);
-                        FACE(1, 7, 11);
-                        FACE(2, 1, 11);
-                        break;
-
-                    case 60:
-                        FACE(8, 5, 7);
-                        FACE(8, 9, 5);
-                        FACE(3, 11, 10);
-                        FACE(3, 10, 1);
-                        break;
-
-                    case 61:
-                        FACE(9, 8, 0);
-                        FACE(0, 8, 7);
-                        FACE(0, 7, 11);
-                        FACE(0, 11, 10);
-                        FACE(0, 10, 1);
-                        break;
-
-                    case 62:
-                        FACE(3, 1, 0);
-                        FACE(0, 1, 10);
-                        FACE(0, 10, 5);
-                        FACE(0, 5, 7);
-                        FACE(0, 7, 8);
-                        break;
-
-                    case 63:
-                        FACE(10, 5, 7);
-                        FACE(11, 10, 7);
-                        break;
-
-                    case 64:
-                        FACE(5, 10, 6);
-                        break;
-
-                    case 65:
-                        FACE(3, 0, 8);
-                        FACE(5, 10, 6);
-                        break;
-
-                    case 66:
-                        FACE(0, 1, 9);
-                        FACE(10, 6, 5);
-                        break;
-
-                    case 67:
-                        FACE(3, 9, 8);
-                        FACE(3, 1, 9);
-                        FACE(10, 6, 5);
-                        break;
-
-                    case 68:
-                        FACE(5, 2, 6);
-                        FACE(5, 1, 2);
-                        break;
-
-                    case 69:
-                        FACE(5, 2, 6);
-                        FACE(5, 1, 2);
-                        FACE(0, 8, 3);
-                        break;
-
-                    case 70:
-                        FACE(9, 6, 5);
-                        FACE(9, 0, 6);
-                        FACE(0, 2, 6);
-                        break;
-
-                    case 71:
-                        FACE(8, 5, 9);
-                        FACE(8, 6, 5);
-                        FACE(8, 3, 6);
-                        FACE(3, 2, 6);
-                        break;
-
-                    case 72:
-                        FACE(5, 10, 6);
-                        FACE(2, 3, 11);
-                        break;
-
-                    case 73:
-                        FACE(8, 2, 0);
-                        FACE(8, 11, 2);
-                        FACE(6, 5, 10);
-                        break;
-
-                    case 74:
-                        FACE(11, 2, 3);
-                        FACE(1, 9, 0);
-                        FACE(4, 10, 6);
-                        break;
-
-                    case 75:
-                        FACE(1, 11, 2);
-                        FACE(1, 9, 11);
-                        FACE(9, 8, 11);
-                        FACE(2, 5, 10);
-                        break;
-
-                    case 76:
-                        FACE(6, 3, 11);
-                        FACE(6, 5, 3);
-                        FACE(5, 1, 3);
-                        break;
-
-                    case 77:
-                        FACE(1, 0, 5);
-                        FACE(5, 0, 8);
-                        FACE(5, 8, 6);
-                        FACE(6, 8, 11);
-                        break;
-
-                    case 78:
-                        FACE(0, 3, 9);
-                        FACE(9, 3, 11);
-                        FACE(9, 11, 5);
-                        FACE(5, 11, 6);
-                        break;
-
-                    case 79:
-                        FACE(9, 8, 11);
-                        FACE(9, 11, 6);
-                        FACE(5, 9, 6);
-                        break;
-
-                    case 80:
-                        FACE(8, 4, 7);
-                        FACE(5, 10, 6);
-                        break;
-
-                    case 81:
-                        FACE(0, 7, 3);
-                        FACE(0, 4, 7);
-                        FACE(5, 10, 6);
-                        break;
-
-                    case 82:
-                        FACE(8, 4, 7);
-                        FACE(5, 10, 6);
-                        FACE(2, 9, 0);
-                        break;
-
-                    case 83:
-                        FACE(4, 1, 9);
-                        FACE(4, 7, 1);
-                        FACE(7, 3, 1);
-                        FACE(9, 6, 5);
-                        break;
-
-                    case 84:
-                        FACE(2, 5, 1);
-                        FACE(2, 6, 5);
-                        FACE(7, 8, 4);
-                        break;
-
-                    case 85:
-                        FACE(0, 7, 3);
-                        FACE(0, 4, 7);
-                        FACE(1, 2, 6);
-                        FACE(1, 6, 5);
-                        break;
-
-                    case 86:
-                        FACE(9, 6, 5);
-                        FACE(9, 0, 6);
-                        FACE(0, 2, 6);
-                        FACE(5, 8, 4);
-                        break;
-
-                    case 87:
-                        FACE(4, 0, 9);
-                        FACE(9, 0, 3);
-                        FACE(9, 3, 2);
-                        FACE(9, 2, 6);
-                        FACE(9, 6, 5);
-                        break;
-
-                    case 88:
-                        FACE(10, 6, 5);
-                        FACE(7, 8, 4);
-                        FACE(0, 11, 2);
-                        break;
-
-                    case 89:
-                        FACE(11, 4, 7);
-                        FACE(11, 2, 4);
-                        FACE(2, 0, 4);
-                        FACE(7, 10, 6);
-                        break;
-
-                    case 90:
-                        FACE(8, 4, 7);
-                        FACE(5, 10, 6);
-                        FACE(1, 9, 0);
-                        FACE(2, 3, 11);
-                        break;
-
-                    case 91:
-                        FACE(10, 6, 5);
-                        FACE(2, 1, 11);
-                        FACE(11, 1, 9);
-                        FACE(11, 9, 7);
-                        FACE(7, 9, 4);
-                        break;
-
-                    case 92:
-                        FACE(6, 3, 11);
-                        FACE(6, 5, 3);
-                        FACE(5, 1, 3);
-                        FACE(11, 4, 7);
-                        break;
-
-                    case 93:
-                        FACE(6, 2, 11);
-                        FACE(11, 2, 1);
-                        FACE(11, 1, 0);
-                        FACE(11, 0, 4);
-                        FACE(11, 4, 7);
-                        break;
-
-                    case 94:
-                        FACE(8, 4, 7);
-                        FACE(0, 3, 9);
-                        FACE(9, 3, 11);
-                        FACE(9, 11, 5);
-                        FACE(5, 11, 6);
-                        break;
-
-                    case 95:
-                        FACE(6, 2, 11);
-                        FACE(2, 9, 11);
-                        FACE(9, 4, 11);
-                        FACE(11, 4, 7);
-                        break;
-
-                    case 96:
-                        FACE(9, 6, 4);
-                        FACE(9, 10, 6);
-                        break;
-
-                    case 97:
-                        FACE(6, 9, 10);
-                        FACE(6, 4, 9);
-                        FACE(8, 3, 0);
-                        break;
-
-                    case 98:
-                        FACE(10, 0, 1);
-                        FACE(10, 6, 0);
-                        FACE(6, 4, 0);
-                        break;
-
-                    case 99:
-                        FACE(4, 8, 6);
-                        FACE(6, 8, 3);
-                        FACE(6, 3, 10);
-                        FACE(10, 3, 1);
-                        break;
-
-                    case 100:
-                        FACE(1, 4, 9);
-                        FACE(1, 2, 4);
-                        FACE(2, 6, 4);
-                        break;
-
-                    case 101:
-                        FACE(1, 4, 9);
-                        FACE(1, 2, 4);
-                        FACE(2, 6, 4);
-                        FACE(9, 3, 0);
-                        break;
-
-                    case 102:
-                        FACE(6, 4, 2);
-                        FACE(2, 4, 0);
-                        break;
-
-                    case 103:
-                        FACE(8, 2, 3);
-                        FACE(8, 4, 2);
-                        FACE(4, 6, 2);
-                        break;
-
-                    case 104:
-                        FACE(9, 6, 4);
-                        FACE(9, 10, 6);
-                        FACE(2, 3, 11);
-                        break;
-
-                    case 105:
-                        FACE(2, 8, 11);
-                        FACE(2, 0, 8);
-                        FACE(10, 6, 4);
-                        FACE(10, 4, 9);
-                        break;
-
-                    case 106:
-                        FACE(10, 0, 1);
-                        FACE(10, 6, 0);
-                        FACE(6, 4, 0);
-                        FACE(1, 11, 2);
-                        break;
-
-                    case 107:
-                        FACE(10, 9, 1);
-                        FACE(1, 9, 4);
-                        FACE(1, 4, 8);
-                        FACE(1, 8, 11);
-                        FACE(1, 11, 2);
-                        break;
-
-                    case 108:
-                        FACE(3, 9, 1);
-                        FACE(3, 4, 9);
-                        FACE(3, 11, 4);
-                        FACE(11, 6, 4);
-                        break;
-
-                    case 109:
-                        FACE(0, 2, 1);
-                        FACE(1, 2, 11);
-                        FACE(1, 11, 6);
-                        FACE(1, 6, 4);
-                        FACE(1, 4, 9);
-                        break;
-
-                    case 110:
-                        FACE(6, 4, 0);
-                        FACE(6, 0, 3);
-                        FACE(11, 6, 3);
-                        break;
-
-                    case 111:
-                        FACE(11, 6, 4);
-                        FACE(8, 11, 4);
-                        break;
-
-                    case 112:
-                        FACE(7, 10, 6);
-                        FACE(7, 8, 10);
-                        FACE(8, 9, 10);
-                        break;
-
-                    case 113:
-                        FACE(10, 0, 9);
-                        FACE(10, 3, 0);
-                        FACE(10, 6, 3);
-                        FACE(6, 7, 3);
-                        break;
-
-                    case 114:
-                        FACE(6, 7, 10);
-                        FACE(10, 7, 8);
-                        FACE(10, 8, 1);
-                        FACE(1, 8, 0);
-                        break;
-
-                    case 115:
-                        FACE(7, 3, 1);
-                        FACE(7, 1, 10);
-                        FACE(6, 7, 10);
-                        break;
-
-                    case 116:
-                        FACE(6, 7, 2);
-                        FACE(2, 7, 8);
-                        FACE(2, 8, 1);
-                        FACE(1, 8, 9);
-                        break;
-
-                    case 117:
-                        FACE(1, 5, 9);
-                        FACE(9, 5, 6);
-                        FACE(9, 6, 7);
-                        FACE(9, 7, 3);
-                        FACE(9, 3, 0);
-                        break;
-
-                    case 118:
-                        FACE(0, 2, 6);
-                        FACE(0, 6, 7);
-                        FACE(8, 0, 7);
-                        break;
-
-                    case 119:
-                        FACE(3, 2, 6);
-                        FACE(7, 3, 6);
-                        break;
-
-                    case 120:
-                        FACE(7, 10, 6);
-                        FACE(7, 8, 10);
-                        FACE(8, 9, 10);
-                        FACE(6, 3, 11);
-                        break;
-
-                    case 121:
-                        FACE(11, 8, 7);
-                        FACE(7, 8, 0);
-                        FACE(7, 0, 9);
-                        FACE(7, 9, 10);
-                        FACE(7, 10, 6);
-                        break;
-
-                    case 122:
-                        FACE(11, 2, 3);
-                        FACE(6, 7, 10);
-                        FACE(10, 7, 8);
-                        FACE(10, 8, 1);
-                        FACE(1, 8, 0);
-                        break;
-
-                    case 123:
-                        FACE(10, 9, 1);
-                        FACE(9, 7, 1);
-                        FACE(7, 11, 1);
-                        FACE(1, 11, 2);
-                        break;
-
-                    case 124:
-                        FACE(7, 5, 6);
-                        FACE(6, 5, 9);
-                        FACE(6, 9, 1);
-                        FACE(6, 1, 3);
-                        FACE(6, 3, 11);
-                        break;
-
-                    case 125:
-                        FACE(0, 9, 1);
-                        FACE(11, 6, 7);
-                        break;
-
-                    case 126:
-                        FACE(3, 1, 0);
-                        FACE(1, 6, 0);
-                        FACE(6, 7, 0);
-                        FACE(0, 7, 8);
-                        break;
-
-                    case 127:
-                        FACE(11, 6, 7);
-                        break;
-
-                    case 128:
-                        FACE(7, 6, 11);
-                        break;
-
-                    case 129:
-                        FACE(6, 11, 7);
-                        FACE(3, 0, 8);
-                        break;
-
-                    case 130:
-                        FACE(7, 6, 11);
-                        FACE(1, 9, 0);
-                        break;
-
-                    case 131:
-                        FACE(9, 3, 1);
-                        FACE(9, 8, 3);
-                        FACE(7, 6, 11);
-                        break;
-
-                    case 132:
-                        FACE(7, 6, 11);
-                        FACE(10, 1, 2);
-                        break;
-
-                    case 133:
-                        FACE(1, 2, 10);
-                        FACE(11, 7, 6);
-                        FACE(4, 3, 0);
-                        break;
-
-                    case 134:
-                        FACE(0, 10, 9);
-                        FACE(0, 2, 10);
-                        FACE(11, 7, 6);
-                        break;
-
-                    case 135:
-                        FACE(2, 8, 3);
-                        FACE(2, 10, 8);
-                        FACE(10, 9, 8);
-                        FACE(3, 6, 11);
-                        break;
-
-                    case 136:
-                        FACE(6, 3, 7);
-                        FACE(6, 2, 3);
-                        break;
-
-                    case 137:
-                        FACE(7, 0, 8);
-                        FACE(7, 6, 0);
-                        FACE(6, 2, 0);
-                        break;
-
-                    case 138:
-                        FACE(6, 3, 7);
-                        FACE(6, 2, 3);
-                        FACE(1, 9, 0);
-                        break;
-
-                    case 139:
-                        FACE(2, 1, 6);
-                        FACE(6, 1, 9);
-                        FACE(6, 9, 7);
-                        FACE(7, 9, 8);
-                        break;
-
-                    case 140:
-                        FACE(10, 7, 6);
-                        FACE(10, 1, 7);
-                        FACE(1, 3, 7);
-                        break;
-
-                    case 141:
-                        FACE(6, 10, 7);
-                        FACE(7, 10, 1);
-                        FACE(7, 1, 8);
-                        FACE(8, 1, 0);
-                        break;
-
-                    case 142:
-                        FACE(9, 6, 10);
-                        FACE(9, 7, 6);
-                        FACE(9, 0, 7);
-                        FACE(0, 3, 7);
-                        break;
-
-                    case 143:
-                        FACE(10, 9, 8);
-                        FACE(10, 8, 7);
-                        FACE(6, 10, 7);
-                        break;
-
-                    case 144:
-                        FACE(4, 11, 8);
-                        FACE(4, 6, 11);
-                        break;
-
-                    case 145:
-                        FACE(3, 6, 11);
-                        FACE(3, 0, 6);
-                        FACE(0, 4, 6);
-                        break;
-
-                    case 146:
-                        FACE(11, 4, 6);
-                        FACE(11, 8, 4);
-                        FACE(0, 1, 9);
-                        break;
-
-                    case 147:
-                        FACE(1, 11, 3);
-                        FACE(1, 6, 11);
-                        FACE(1, 9, 6);
-                        FACE(9, 4, 6);
-                        break;
-
-                    case 148:
-                        FACE(4, 11, 8);
-                        FACE(4, 6, 11);
-                        FACE(10, 1, 2);
-                        break;
-
-                    case 149:
-                        FACE(3, 6, 11);
-                        FACE(3, 0, 6);
-                        FACE(0, 4, 6);
-                        FACE(11, 1, 2);
-                        break;
-
-                    case 150:
-                        FACE(4, 11, 8);
-                        FACE(4, 6, 11);
-                        FACE(9, 0, 2);
-                        FACE(9, 2, 10);
-                        break;
-
-                    case 151:
-                        FACE(2, 0, 3);
-                        FACE(3, 0, 9);
-                        FACE(3, 9, 4);
-                        FACE(3, 4, 6);
-                        FACE(3, 6, 11);
-                        break;
-
-                    case 152:
-                        FACE(8, 2, 3);
-                        FACE(8, 4, 2);
-                        FACE(4, 6, 2);
-                        break;
-
-                    case 153:
-                        FACE(4, 6, 0);
-                        FACE(0, 6, 2);
-                        break;
-
-                    case 154:
-                        FACE(8, 2, 3);
-                        FACE(8, 4, 2);
-                        FACE(4, 6, 2);
-                        FACE(3, 9, 0);
-                        break;
-
-                    case 155:
-                        FACE(4, 6, 2);
-                        FACE(4, 2, 1);
-                        FACE(9, 4, 1);
-                        break;
-
-                    case 156:
-                        FACE(6, 10, 4);
-                        FACE(4, 10, 1);
-                        FACE(4, 1, 8);
-                        FACE(8, 1, 3);
-                        break;
-
-                    case 157:
-                        FACE(0, 4, 6);
-                        FACE(0, 6, 10);
-                        FACE(1, 0, 10);
-                        break;
-
-                    case 158:
-                        FACE(8, 11, 3);
-                        FACE(3, 11, 6);
-                        FACE(3, 6, 10);
-                        FACE(3, 10, 9);
-                        FACE(3, 9, 0);
-                        break;
-
-                    case 159:
-                        FACE(6, 10, 9);
-                        FACE(4, 6, 9);
-                        break;
-
-                    case 160:
-                        FACE(9, 5, 4);
-                        FACE(6, 11, 7);
-                        break;
-
-                    case 161:
-                        FACE(5, 4, 9);
-                        FACE(8, 3, 0);
-                        FACE(2, 7, 6);
-                        break;
-
-                    case 162:
-                        FACE(1, 4, 0);
-                        FACE(1, 5, 4);
-                        FACE(6, 11, 7);
-                        break;
-
-                    case 163:
-                        FACE(8, 5, 4);
-                        FACE(8, 3, 5);
-                        FACE(3, 1, 5);
-                        FACE(4, 11, 7);
-                        break;
-
-                    case 164:
-                        FACE(7, 6, 11);
-                        FACE(10, 1, 2);
-                        FACE(0, 5, 4);
-                        break;
-
-                    case 165:
-                        FACE(3, 0, 8);
-                        FACE(9, 5, 4);
-                        FACE(10, 1, 2);
-                        FACE(6, 11, 7);
-                        break;
-
-                    case 166:
-                        FACE(5, 2, 10);
-                        FACE(5, 4, 2);
-                        FACE(4, 0, 2);
-                        FACE(10, 7, 6);
-                        break;
-
-                    case 167:
-                        FACE(7, 6, 11);
-                        FACE(4, 8, 5);
-                        FACE(5, 8, 3);
-                        FACE(5, 3, 10);
-                        FACE(10, 3, 2);
-                        break;
-
-                    case 168:
-                        FACE(3, 6, 2);
-                        FACE(3, 7, 6);
-                        FACE(4, 9, 5);
-                        break;
-
-                    case 169:
-                        FACE(7, 0, 8);
-                        FACE(7, 6, 0);
-                        FACE(6, 2, 0);
-                        FACE(8, 5, 4);
-                        break;
-
-                    case 170:
-                        FACE(6, 3, 7);
-                        FACE(6, 2, 3);
-                        FACE(5, 4, 0);
-                        FACE(5, 0, 1);
-                        break;
-
-                    case 171:
-                        FACE(7, 3, 8);
-                        FACE(8, 3, 2);
-                        FACE(8, 2, 1);
-                        FACE(8, 1, 5);
-                        FACE(8, 5, 4);
-                        break;
-
-                    case 172:
-                        FACE(10, 7, 6);
-                        FACE(10, 1, 7);
-                        FACE(1, 3, 7);
-                        FACE(6, 9, 5);
-                        break;
-
-                    case 173:
-                        FACE(5, 4, 9);
-                        FACE(6, 10, 7);
-                        FACE(7, 10, 1);
-                        FACE(7, 1, 8);
-                        FACE(8, 1, 0);
-                        break;
-
-                    case 174:
-                        FACE(5, 1, 10);
-                        FACE(10, 1, 0);
-                        FACE(10, 0, 3);
-                        FACE(10, 3, 7);
-                        FACE(10, 7, 6);
-                        break;
-
-                    case 175:
-                        FACE(5, 1, 10);
-                        FACE(1, 8, 10);
-                        FACE(8, 7, 10);
-                        FACE(10, 7, 6);
-                        break;
-
-                    case 176:
-                        FACE(6, 9, 5);
-                        FACE(6, 11, 9);
-                        FACE(11, 8, 9);
-                        break;
-
-                    case 177:
-                        FACE(0, 9, 3);
-                        FACE(3, 9, 5);
-                        FACE(3, 5, 11);
-                        FACE(11, 5, 6);
-                        break;
-
-                    case 178:
-                        FACE(5, 6, 1);
-                        FACE(1, 6, 11);
-                        FACE(1, 11, 0);
-                        FACE(0, 11, 8);
-                        break;
-
-                    case 179:
-                        FACE(3, 1, 5);
-                        FACE(3, 5, 6);
-                        FACE(11, 3, 6);
-                        break;
-
-                    case 180:
-                        FACE(6, 9, 5);
-                        FACE(6, 11, 9);
-                        FACE(11, 8, 9);
-                        FACE(5, 2, 10);
-                        break;
-
-                    case 181:
-                        FACE(1, 2, 10);
-                        FACE(0, 9, 3);
-                        FACE(3, 9, 5);
-                        FACE(3, 5, 11);
-                        FACE(11, 5, 6);
-                        break;
-
-                    case 182:
-                        FACE(6, 4, 5);
-                        FACE(5, 4, 8);
-                        FACE(5, 8, 0);
-                        FACE(5, 0, 2);
-                        FACE(5, 2, 10);
-                        break;
-
-                    case 183:
-                        FACE(2, 0, 3);
-                        FACE(0, 5, 3);
-                        FACE(5, 6, 3);
-                        FACE(3, 6, 11);
-                        break;
-
-                    case 184:
-                        FACE(9, 3, 8);
-                        FACE(9, 2, 3);
-                        FACE(9, 5, 2);
-                        FACE(5, 6, 2);
-                        break;
-
-                    case 185:
-                        FACE(6, 2, 0);
-                        FACE(6, 0, 9);
-                        FACE(5, 6, 9);
-                        break;
-
-                    case 186:
-                        FACE(0, 4, 8);
-                        FACE(8, 4, 5);
-                        FACE(8, 5, 6);
-                        FACE(8, 6, 2);
-                        FACE(8, 2, 3);
-                        break;
-
-                    case 187:
-                        FACE(2, 1, 5);
-                        FACE(6, 2, 5);
-                        break;
-
-                    case 188:
-                        FACE(10, 11, 6);
-                        FACE(6, 11, 3);
-                        FACE(6, 3, 8);
-                        FACE(6, 8, 9);
-                        FACE(6, 9, 5);
-                        break;
-
-                    case 189:
-                        FACE(10, 11, 6);
-                        FACE(11, 0, 6);
-                        FACE(0, 9, 6);
-                        FACE(6, 9, 5);
-                        break;
-
-                    case 190:
-                        FACE(6, 10, 5);
-                        FACE(8, 0, 3);
-                        break;
-
-                    case 191:
-                        FACE(6, 10, 5);
-                        break;
-
-                    case 192:
-                        FACE(7, 10, 11);
-                        FACE(7, 5, 10);
-                        break;
-
-                    case 193:
-                        FACE(10, 7, 5);
-                        FACE(10, 11, 7);
-                        FACE(3, 0, 8);
-                        break;
-
-                    case 194:
-                        FACE(7, 10, 11);
-                        FACE(7, 5, 10);
-                        FACE(9, 0, 1);
-                        break;
-
-                    case 195:
-                        FACE(3, 9, 8);
-                        FACE(3, 1, 9);
-                        FACE(11, 7, 5);
-                        FACE(11, 5, 10);
-                        break;
-
-                    case 196:
-                        FACE(11, 1, 2);
-                        FACE(11, 7, 1);
-                        FACE(7, 5, 1);
-                        break;
-
-                    case 197:
-                        FACE(11, 1, 2);
-                        FACE(11, 7, 1);
-                        FACE(7, 5, 1);
-                        FACE(2, 8, 3);
-                        break;
-
-                    case 198:
-                        FACE(2, 11, 0);
-                        FACE(0, 11, 7);
-                        FACE(0, 7, 9);
-                        FACE(9, 7, 5);
-                        break;
-
-                    case 199:
-                        FACE(11, 10, 2);
-                        FACE(2, 10, 5);
-                        FACE(2, 5, 9);
-                        FACE(2, 9, 8);
-                        FACE(2, 8, 3);
-                        break;
-
-                    case 200:
-                        FACE(2, 5, 10);
-                        FACE(2, 3, 5);
-                        FACE(3, 7, 5);
-                        break;
-
-                    case 201:
-                        FACE(5, 8, 7);
-                        FACE(5, 0, 8);
-                        FACE(5, 10, 0);
-                        FACE(10, 2, 0);
-                        break;
-
-                    case 202:
-                        FACE(2, 5, 10);
-                        FACE(2, 3, 5);
-                        FACE(3, 7, 5);
-                        FACE(10, 0, 1);
-                        break;
-
-                    case 203:
-                        FACE(1, 3, 2);
-                        FACE(2, 3, 8);
-                        FACE(2, 8, 7);
-                        FACE(2, 7, 5);
-                        FACE(2, 5, 10);
-                        break;
-
-                    case 204:
-                        FACE(1, 3, 5);
-                        FACE(5, 3, 7);
-                        break;
-
-                    case 205:
-                        FACE(7, 5, 1);
-                        FACE(7, 1, 0);
-                        FACE(8, 7, 0);
-                        break;
-
-                    case 206:
-                        FACE(3, 7, 5);
-                        FACE(3, 5, 9);
-                        FACE(0, 3, 9);
-                        break;
-
-                    case 207:
-                        FACE(5, 9, 8);
-                        FACE(7, 5, 8);
-                        break;
-
-                    case 208:
-                        FACE(5, 8, 4);
-                        FACE(5, 10, 8);
-                        FACE(10, 11, 8);
-                        break;
-
-                    case 209:
-                        FACE(4, 5, 0);
-                        FACE(0, 5, 10);
-                        FACE(0, 10, 3);
-                        FACE(3, 10, 11);
-                        break;
-
-                    case 210:
-                        FACE(5, 8, 4);
-                        FACE(5, 10, 8);
-                        FACE(10, 11, 8);
-                        FACE(4, 1, 9);
-                        break;
-
-                    case 211:
-                        FACE(5, 7, 4);
-                        FACE(4, 7, 11);
-                        FACE(4, 11, 3);
-                        FACE(4, 3, 1);
-                        FACE(4, 1, 9);
-                        break;
-
-                    case 212:
-                        FACE(1, 4, 5);
-                        FACE(1, 8, 4);
-                        FACE(1, 2, 8);
-                        FACE(2, 11, 8);
-                        break;
-
-                    case 213:
-                        FACE(3, 7, 11);
-                        FACE(11, 7, 4);
-                        FACE(11, 4, 5);
-                        FACE(11, 5, 1);
-                        FACE(11, 1, 2);
-                        break;
-
-                    case 214:
-                        FACE(9, 10, 5);
-                        FACE(5, 10, 2);
-                        FACE(5, 2, 11);
-                        FACE(5, 11, 8);
-                        FACE(5, 8, 4);
-                        break;
-
-                    case 215:
-                        FACE(4, 5, 9);
-                        FACE(3, 2, 11);
-                        break;
-
-                    case 216:
-                        FACE(4, 5, 8);
-                        FACE(8, 5, 10);
-                        FACE(8, 10, 3);
-                        FACE(3, 10, 2);
-                        break;
-
-                    case 217:
-                        FACE(2, 0, 4);
-                        FACE(2, 4, 5);
-                        FACE(10, 2, 5);
-                        break;
-
-                    case 218:
-                        FACE(9, 0, 1);
-                        FACE(4, 5, 8);
-                        FACE(8, 5, 10);
-                        FACE(8, 10, 3);
-                        FACE(3, 10, 2);
-                        break;
-
-                    case 219:
-                        FACE(5, 7, 4);
-                        FACE(7, 2, 4);
-                        FACE(2, 1, 4);
-                        FACE(4, 1, 9);
-                        break;
-
-                    case 220:
-                        FACE(5, 1, 3);
-                        FACE(5, 3, 8);
-                        FACE(4, 5, 8);
-                        break;
-
-                    case 221:
-                        FACE(4, 5, 1);
-                        FACE(0, 4, 1);
-                        break;
-
-                    case 222:
-                        FACE(9, 10, 5);
-                        FACE(10, 3, 5);
-                        FACE(3, 8, 5);
-                        FACE(5, 8, 4);
-                        break;
-
-                    case 223:
-                        FACE(4, 5, 9);
-                        break;
-
-                    case 224:
-                        FACE(4, 11, 7);
-                        FACE(4, 9, 11);
-                        FACE(9, 10, 11);
-                        break;
+}
 
-                    case 225:
-                        FACE(4, 11, 7);
-                        FACE(4, 9, 11);
-                        FACE(9, 10, 11);
-                        FACE(7, 0, 8);
-                        break;
+/// Counts the crossing edges `number_plane_edges` and, given the plane
+/// above, `number_z_edges` would number.
+static auto count_crossings(const float *plane, const float *upper, int nx, int ny) -> std::uint32_t {
+    auto count = 0u;
+    for (auto y = 0; y < ny; y++) {
+        for (auto x = 0; x < nx; x++) {
+            const auto v = (std::size_t) y * nx + x;
+            const auto inside = plane[v] < 0;
+            count += x < nx - 1 && (plane[v + 1] < 0) != inside;
+            count += y < ny - 1 && (plane[v + nx] < 0) != inside;
+            count += upper != nullptr && (upper[v] < 0) != inside;
+        }
+    }
+    return count;
+}
 
-                    case 226:
-                        FACE(11, 1, 10);
-                        FACE(11, 0, 1);
-                        FACE(11, 7, 0);
-                        FACE(7, 4, 0);
-                        break;
+/// Triangulates rows [y_begin, y_end) of the cells between two vertex planes.
+/// @param states receives the state of every cell of the layer, may be null
+/// @param out receives three vertex ids per triangle
+/// @returns number of cells crossing the surface
+static auto triangulate_layer(const float *lower, const float *upper, int nx, int ny,
+                              int y_begin, int y_end,
+                              const std::uint32_t *lower_ids, const std::uint32_t *upper_ids,
+                              const std::uint32_t *z_ids, std::uint8_t *states,
+                              std::vector<std::uint32_t> &out) -> int {
+    const auto plane_size = (std::size_t) nx * ny;
+    auto num_faces = 0;
+    for (auto y = y_begin; y < y_end; y++) {
+        for (auto x = 0; x < nx - 1; x++) {
+            Cell cell;
+            cell.state = 0;
+            for (auto i = 0; i < 8; i++) {
+                const auto *plane = corner_offsets[i][2] == 0 ? lower : upper;
+                cell.values[i] = plane[(std::size_t) (y + corner_offsets[i][1]) * nx + x + corner_offsets[i][0]];
+                cell.state |= (cell.values[i] < 0) << i;
+            }
+            // Corners outside the surface set the bits
+            cell.state = ~cell.state & 0xff;
+            if (states != nullptr) {
+                states[(std::size_t) y * nx + x] = (std::uint8_t) cell.state;
+            }
+            if (cell.state == 0 || cell.state == 255) {
+                continue;
+            }
+            num_faces++;
+
+            const auto *triangles = triangle_table[cell.state];
+            for (auto t = 0; triangles[t] != -1; t++) {
+                const auto &slot = edge_slots[triangles[t]];
+                const auto local = (std::size_t) (y + slot.dy) * nx + (x + slot.dx);
+                const auto *ids = slot.dz == 0 ? lower_ids : upper_ids;
+                out.push_back(slot.axis == 2 ? z_ids[local] : ids[slot.axis * plane_size + local]);
+            }
+        }
+    }
+    return num_faces;
+}
 
-                    case 227:
-                        FACE(8, 9, 4);
-                        FACE(4, 9, 1);
-                        FACE(4, 1, 10);
-                        FACE(4, 10, 11);
-                        FACE(4, 11, 7);
-                        break;
+auto CubeMarcher::init(cv::Vec3i size, float resolution, GridMode mode) -> void {
+    this->mode = mode;
+    if (mode == GridMode::dense) {
+        cell_mat.resize(size);
+    } else {
+        cell_mat = CellMat();
+        sdf_grid = FlatGrid<float>();
+    }
+    band = FlatGrid<std::uint8_t>();
+    sdf_bricks.clear();
+    std::vector<std::uint8_t>().swap(band_bricks);
+    std::vector<cv::Point3f>().swap(band_centers);
+    this->size = size;
+    this->resolution = resolution;
+}
 
-                    case 228:
-                        FACE(2, 11, 1);
-                        FACE(1, 11, 7);
-                        FACE(1, 7, 9);
-                        FACE(9, 7, 4);
-                        break;
+auto CubeMarcher::stored_vertices() const -> std::size_t {
+    if (mode == GridMode::sparse) {
+        return sdf_bricks.num_bricks() * BrickGrid<float>::volume;
+    } else if (mode == GridMode::streaming) {
+        return (std::size_t) size(0) * size(1) * 2;
+    }
+    return (std::size_t) size(0) * size(1) * size(2);
+}
 
-                    case 229:
-                        FACE(3, 0, 8);
-                        FACE(2, 11, 1);
-                        FACE(1, 11, 7);
-                        FACE(1, 7, 9);
-                        FACE(9, 7, 4);
-                        break;
+auto CubeMarcher::use_pool(ThreadPool *pool) -> void {
+    this->pool = pool;
+}
 
-                    case 230:
-                        FACE(4, 0, 2);
-                        FACE(4, 2, 11);
-                        FACE(7, 4, 11);
-                        break;
+auto CubeMarcher::thread_pool() -> ThreadPool & {
+    if (pool != nullptr) {
+        return *pool;
+    }
+    if (!own_pool) {
+        own_pool = std::make_unique<ThreadPool>();
+    }
+    return *own_pool;
+}
 
-                    case 231:
-                        FACE(8, 9, 4);
-                        FACE(9, 2, 4);
-                        FACE(2, 11, 4);
-                        FACE(4, 11, 7);
-                        break;
+auto CubeMarcher::set_band(const std::vector<cv::Point3f> &centers,
+                           float radius,
+                           cv::Point3f offset,
+                           std::size_t max_vertices) -> bool {
+    if (mode == GridMode::sparse) {
+        return set_band_sparse(centers, radius, offset, max_vertices);
+    } else if (mode == GridMode::streaming) {
+        // Splatted plane by plane while marching
+        band_centers = centers;
+        band_radius = radius;
+        std::sort(band_centers.begin(), band_centers.end(), [] (const cv::Point3f &a, const cv::Point3f &b) {
+            return a.z < b.z;
+        });
+        return true;
+    }
+    band.resize(size, 0);
+    auto &pool = thread_pool();
+    const auto squared_radius = radius * radius;
+    const auto reach = (int) ceilf(radius / resolution);
+
+    // Splat every center into the vertices around it. Each chunk owns a
+    // range of z planes and only writes there, so no locking is needed.
+    pool.parallel_for(size(2), pool.grain(size(2)), [&] (std::size_t plane_begin, std::size_t plane_end) {
+        const auto z_begin = (int) plane_begin, z_end = (int) plane_end;
+        for (const auto &center : centers) {
+            const auto local = (center - offset) / resolution;
+            const auto cx = (int) floorf(local.x), cy = (int) floorf(local.y), cz = (int) floorf(local.z);
+            const auto z_min = std::max(z_begin, cz - reach), z_max = std::min(z_end - 1, cz + reach + 1);
+            if (z_min > z_max) {
+                continue;
+            }
+            const auto y_min = std::max(0, cy - reach), y_max = std::min(size(1) - 1, cy + reach + 1);
+            const auto x_min = std::max(0, cx - reach), x_max = std::min(size(0) - 1, cx + reach + 1);
+            for (auto z = z_min; z <= z_max; z++) {
+                for (auto y = y_min; y <= y_max; y++) {
+                    for (auto x = x_min; x <= x_max; x++) {
+                        const auto d = offset + cv::Point3f(x * resolution, y * resolution, z * resolution) - center;
+                        if (d.dot(d) <= squared_radius) {
+                            band(x, y, z) = 1;
+                        }
+                    }
+                }
+            }
+        }
+    });
 
-                    case 232:
-                        FACE(10, 2, 9);
-                        FACE(9, 2, 3);
-                        FACE(9, 3, 4);
-                        FACE(4, 3, 7);
-                        break;
+    const auto num_active = std::count(band.data.begin(), band.data.end(), 1);
+    HOPPE_LOG("Narrow band: %ld of %lu vertices (%.2f%%)", num_active, band.data.size(),
+              100.0 * num_active / band.data.size());
+    return true;
+}
 
-                    case 233:
-                        FACE(4, 6, 7);
-                        FACE(7, 6, 10);
-                        FACE(7, 10, 2);
-                        FACE(7, 2, 0);
-                        FACE(7, 0, 8);
-                        break;
+auto CubeMarcher::count_center_bricks(const std::vector<cv::Point3f> &centers,
+                                      float resolution,
+                                      cv::Point3f offset) -> std::size_t {
+    constexpr auto bits = BrickGrid<float>::bits;
+    std::vector<std::uint64_t> keys(centers.size());
+    for (auto i = 0ul; i < centers.size(); i++) {
+        const auto local = (centers[i] - offset) / resolution;
+        keys[i] = BrickGrid<float>::key(std::max(0, (int) floorf(local.x)) >> bits,
+                                        std::max(0, (int) floorf(local.y)) >> bits,
+                                        std::max(0, (int) floorf(local.z)) >> bits);
+    }
+    std::sort(keys.begin(), keys.end());
+    return std::unique(keys.begin(), keys.end()) - keys.begin();
+}
 
-                    case 234:
-                        FACE(2, 6, 10);
-                        FACE(10, 6, 7);
-                        FACE(10, 7, 4);
-                        FACE(10, 4, 0);
-                        FACE(10, 0, 1);
-                        break;
+auto CubeMarcher::set_band_sparse(const std::vector<cv::Point3f> &centers,
+                                  float radius,
+                                  cv::Point3f offset,
+                                  std::size_t max_vertices) -> bool {
+    constexpr auto bits = BrickGrid<float>::bits;
+    constexpr auto width = BrickGrid<float>::width;
+    constexpr auto volume = BrickGrid<float>::volume;
+    auto &pool = thread_pool();
+    const auto squared_radius = radius * radius;
+    const auto reach = (int) ceilf(radius / resolution);
+
+    // Vertices a center may reach, clamped to the grid
+    const auto vertex_bounds = [&] (const cv::Point3f &center, cv::Vec3i &lower, cv::Vec3i &upper) {
+        const auto local = (center - offset) / resolution;
+        const cv::Vec3i cell((int) floorf(local.x), (int) floorf(local.y), (int) floorf(local.z));
+        for (auto axis = 0; axis < 3; axis++) {
+            lower(axis) = std::max(0, cell(axis) - reach);
+            upper(axis) = std::min(size(axis) - 1, cell(axis) + reach + 1);
+        }
+        return lower(0) <= upper(0) && lower(1) <= upper(1) && lower(2) <= upper(2);
+    };
 
-                    case 235:
-                        FACE(8, 4, 7);
-                        FACE(10, 1, 2);
-                        break;
+    // Collect the bricks under every center. Bricks reach one vertex further
+    // down than the band, so the lower corner of every cell and edge touching
+    // the band is allocated too and the marching pass can own it.
+    const auto centers_grain = pool.grain(centers.size());
+    std::vector<std::vector<std::uint64_t> > chunk_keys(ThreadPool::num_chunks(centers.size(), centers_grain));
+    pool.parallel_for(centers.size(), centers_grain, [&] (std::size_t begin, std::size_t end) {
+        auto &keys = chunk_keys[begin / centers_grain];
+        for (auto i = begin; i < end; i++) {
+            cv::Vec3i lower, upper;
+            if (!vertex_bounds(centers[i], lower, upper)) {
+                continue;
+            }
+            for (auto bz = std::max(0, lower(2) - 1) >> bits; bz <= upper(2) >> bits; bz++) {
+                for (auto by = std::max(0, lower(1) - 1) >> bits; by <= upper(1) >> bits; by++) {
+                    for (auto bx = std::max(0, lower(0) - 1) >> bits; bx <= upper(0) >> bits; bx++) {
+                        keys.push_back(BrickGrid<float>::key(bx, by, bz));
+                    }
+                }
+            }
+        }
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    });
+
+    // Keys sort in z, y, x order, so bricks are laid out like a dense grid
+    std::vector<std::uint64_t> keys;
+    for (auto &t : chunk_keys) {
+        keys.insert(keys.end(), t.begin(), t.end());
+        std::vector<std::uint64_t>().swap(t);
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    if (keys.size() * volume > max_vertices) {
+        HOPPE_LOG("Narrow band needs %lu bricks of %d^3, over the budget of %lu vertices",
+                  keys.size(), width, max_vertices);
+        return false;
+    }
+    const auto coordinate_mask = (1ull << 21) - 1;
+    std::vector<cv::Vec3i> coords(keys.size());
+    for (auto b = 0ul; b < keys.size(); b++) {
+        coords[b] = cv::Vec3i((int) (keys[b] & coordinate_mask),
+                              (int) ((keys[b] >> 21) & coordinate_mask),
+                              (int) (keys[b] >> 42));
+    }
+    sdf_bricks.allocate(coords, 1.0f);
+    band_bricks.assign(coords.size() * volume, 0);
+
+    // Splat the band like the dense grid does, one brick z range per chunk
+    const auto brick_planes = (std::size_t) (size(2) + width - 1) / width;
+    pool.parallel_for(brick_planes, pool.grain(brick_planes), [&] (std::size_t bz_begin, std::size_t bz_end) {
+        const auto z_begin = std::min(size(2), (int) bz_begin * width);
+        const auto z_end = std::min(size(2), (int) bz_end * width);
+        for (const auto &center : centers) {
+            cv::Vec3i lower, upper;
+            if (!vertex_bounds(center, lower, upper)) {
+                continue;
+            }
+            lower(2) = std::max(lower(2), z_begin);
+            upper(2) = std::min(upper(2), z_end - 1);
+            if (lower(2) > upper(2)) {
+                continue;
+            }
+            for (auto bz = lower(2) >> bits; bz <= upper(2) >> bits; bz++) {
+                for (auto by = lower(1) >> bits; by <= upper(1) >> bits; by++) {
+                    for (auto bx = lower(0) >> bits; bx <= upper(0) >> bits; bx++) {
+                        const auto b = sdf_bricks.find(bx, by, bz);
+                        auto *in_band = &band_bricks[b * volume];
+                        for (auto z = std::max(lower(2), bz * width); z <= std::min(upper(2), bz * width + width - 1); z++) {
+                            for (auto y = std::max(lower(1), by * width); y <= std::min(upper(1), by * width + width - 1); y++) {
+                                for (auto x = std::max(lower(0), bx * width); x <= std::min(upper(0), bx * width + width - 1); x++) {
+                                    const auto d = offset + cv::Point3f(x * resolution, y * resolution, z * resolution) - center;
+                                    if (d.dot(d) <= squared_radius) {
+                                        in_band[BrickGrid<float>::local_index(x, y, z)] = 1;
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    });
 
-                    case 236:
-                        FACE(1, 3, 7);
-                        FACE(1, 7, 4);
-                        FACE(9, 1, 4);
-                        break;
+    const auto num_active = std::count(band_bricks.begin(), band_bricks.end(), 1);
+    HOPPE_LOG("Narrow band: %ld vertices in %lu bricks of %d^3, %.2f MB",
+              num_active, sdf_bricks.num_bricks(), width,
+              (sdf_bricks.memory_footprint() + band_bricks.capacity()) / 1048576.0);
+    return true;
+}
 
-                    case 237:
-                        FACE(4, 6, 7);
-                        FACE(6, 1, 7);
-                        FACE(1, 0, 7);
-                        FACE(7, 0, 8);
-                        break;
+auto CubeMarcher::march(std::function<std::optional<float> (cv::Point3f)> sdf,
+                        cv::Point3f offset,
+                        MeshSink sink) -> void {
+    stages.clear();
+    if (mode == GridMode::streaming) {
+        march_streaming(sdf, offset, sink);
+        return;
+    }
+    if (mode == GridMode::sparse) {
+        march_sparse(sdf, offset);
+    } else {
+        march_dense(sdf, offset);
+    }
+    if (sink) {
+        sink(std::move(vertices), std::move(indices));
+        std::vector<cv::Point3f>().swap(vertices);
+        std::vector<std::uint32_t>().swap(indices);
+    }
+}
 
-                    case 238:
-                        FACE(0, 7, 3);
-                        FACE(0, 4, 7);
-                        break;
+auto CubeMarcher::march_dense(std::function<std::optional<float> (cv::Point3f)> sdf,
+                              cv::Point3f offset) -> void {
+    const auto volume = (std::size_t) size(0) * size(1) * size(2);
+    auto &pool = thread_pool();
+    // Vertices outside the band cost next to nothing, so chunks are small
+    // enough for idle threads to steal the ones near the surface
+    const auto vertex_grain = (std::size_t) 4096;
+    HOPPE_LOG("Marching %lu vertices on %u threads", volume, pool.size());
+    
+    sdf_grid.resize(size);
+    HOPPE_LOG("Marching grid memory: cells %.2f MB, SDF %.2f MB",
+              cell_mat.memory_footprint() / 1048576.0,
+              sdf_grid.memory_footprint() / 1048576.0);
+
+    // Evaluate the SDF once per grid vertex before classifying cells.
+    // Every vertex belongs to exactly one chunk, so no locking is needed,
+    // and the marching pass below only ever reads the grid. Vertices outside
+    // the band are treated like SDF misses.
+    const StageTimer sdf_timer;
+    std::vector<std::size_t> chunk_queries(ThreadPool::num_chunks(volume, vertex_grain), 0);
+    pool.parallel_for(volume, vertex_grain, [&] (std::size_t begin, std::size_t end) {
+        auto queries = 0ul;
+        for (auto index = begin; index < end; index++) {
+            if (!band.data.empty() && band.data[index] == 0) {
+                sdf_grid.data[index] = 1.0f;
+                continue;
+            }
+            const auto x = index % size(0);
+            const auto y = (index / size(0)) % size(1);
+            const auto z = (index / size(0) / size(1));
+            const auto dist_sdf = sdf(offset + cv::Point3f(x * resolution, y * resolution, z * resolution));
+            sdf_grid.data[index] = dist_sdf.has_value() ? dist_sdf.value() : 1.0f;
+            queries++;
+        }
+        chunk_queries[begin / vertex_grain] = queries;
+    });
+    stages.push_back(sdf_timer.stop("sdf", std::accumulate(chunk_queries.begin(), chunk_queries.end(), 0ul)));
+    const StageTimer triangulation_timer;
+
+    vertices.clear();
+    indices.clear();
+    if (size(0) < 2 || size(1) < 2 || size(2) < 2) {
+        HOPPE_LOG("WARNING! Marching grid too small: %d %d %d", size(0), size(1), size(2));
+        stages.push_back(triangulation_timer.stop("triangulation", 0));
+        return;
+    }
 
-                    case 239:
-                        FACE(8, 4, 7);
-                        break;
+    auto maximum = offset + cv::Point3f(size(0) * resolution,
+                                        size(1) * resolution,
+                                        size(2) * resolution);
+    HOPPE_LOG("Actual maximum: %f %f %f", maximum.x, maximum.y, maximum.z);
 
-                    case 240:
-                        FACE(10, 11, 9);
-                        FACE(9, 11, 8);
-                        break;
+    // Vertices live on grid edges, named by the edge's lower grid vertex and
+    // its axis. Every task marches a slab of z layers and only keeps edge
+    // caches for the two vertex planes and the z edges of the current layer.
+    //
+    // Vertex ids follow one global order: for each z, the crossing x/y edges
+    // of plane z, then the crossing z edges between plane z and z + 1. A
+    // slab owns the planes and z edges of its layers (and the last slab the
+    // top plane too), so it can number its vertices after a counting pass,
+    // and it can name the vertices of the next slab's first plane without
+    // talking to it. The mesh is the same for any number of slabs or threads.
+    const auto nx = size(0), ny = size(1), nz = size(2);
+    const auto plane_size = (std::size_t) nx * ny;
+    const auto num_layers = nz - 1;
+    const auto layers_per_slab = (int) pool.grain(num_layers);
+    const auto num_slabs = (int) ThreadPool::num_chunks(num_layers, layers_per_slab);
+    const auto plane = [&] (int z) {
+        return &sdf_grid.data[z * plane_size];
+    };
+    const cv::Point3f axis_offset[3] = {
+        { resolution * 0.5f, 0.0f, 0.0f },
+        { 0.0f, resolution * 0.5f, 0.0f },
+        { 0.0f, 0.0f, resolution * 0.5f }
+    };
 
-                    case 241:
-                        FACE(9, 10, 11);
-                        FACE(9, 11, 3);
-                        FACE(0, 9, 3);
-                        break;
+    const auto slab_range = [&] (int slab) {
+        const auto z_begin = std::min(num_layers, slab * layers_per_slab);
+        return std::make_pair(z_begin, std::min(num_layers, z_begin + layers_per_slab));
+    };
 
-                    case 242:
-                        FACE(10, 11, 8);
-                        FACE(10, 8, 0);
-                        FACE(1, 10, 0);
-                        break;
+    // Counting pass: vertices owned by every slab
+    std::vector<std::uint32_t> slab_base(num_slabs + 1, 0);
+    pool.parallel_for(num_slabs, 1, [&] (std::size_t slab, std::size_t) {
+        const auto range = slab_range((int) slab);
+        auto count = 0u;
+        for (auto z = range.first; z < range.second; z++) {
+            count += count_crossings(plane(z), plane(z + 1), nx, ny);
+        }
+        if (range.second == num_layers) {
+            count += count_crossings(plane(num_layers), nullptr, nx, ny);
+        }
+        slab_base[slab + 1] = count;
+    });
+    std::partial_sum(slab_base.begin(), slab_base.end(), slab_base.begin());
+    vertices.resize(slab_base[num_slabs]);
+
+    // Marching pass, one slab per task with its own index buffer
+    std::vector<std::vector<std::uint32_t> > slab_indices(num_slabs);
+    std::vector<int> slab_num_faces(num_slabs, 0);
+    pool.parallel_for(num_slabs, 1, [&] (std::size_t slab, std::size_t) {
+        const auto range = slab_range((int) slab);
+        std::vector<std::uint32_t> bottom(plane_size * 2), top(plane_size * 2), z_edges(plane_size);
+        auto next_id = slab_base[slab];
+        auto vertex_z = range.first;
+        const auto store = [&] (int x, int y, int axis, std::uint32_t id) {
+            vertices[id] = offset + cv::Point3f(x * resolution, y * resolution, vertex_z * resolution) + axis_offset[axis];
+        };
 
-                    case 243:
-                        FACE(1, 10, 11);
-                        FACE(3, 1, 11);
-                        break;
+        number_plane_edges(plane(range.first), nx, ny, &bottom[0], next_id, store);
+        for (auto z = range.first; z < range.second; z++) {
+            vertex_z = z;
+            number_z_edges(plane(z), plane(z + 1), nx, ny, &z_edges[0], next_id, store);
+            vertex_z = z + 1;
+            if (z + 1 < range.second || range.second == num_layers) {
+                number_plane_edges(plane(z + 1), nx, ny, &top[0], next_id, store);
+            } else {
+                // First plane of the next slab, which numbers it from its base
+                auto foreign_id = slab_base[slab + 1];
+                number_plane_edges(plane(z + 1), nx, ny, &top[0], foreign_id,
+                                   [] (int, int, int, std::uint32_t) {});
+            }
 
-                    case 244:
-                        FACE(11, 8, 9);
-                        FACE(11, 9, 1);
-                        FACE(2, 11, 1);
-                        break;
+            slab_num_faces[slab] += triangulate_layer(plane(z), plane(z + 1), nx, ny, 0, ny - 1,
+                                                      &bottom[0], &top[0], &z_edges[0],
+                                                      &cell_mat.data[z * plane_size],
+                                                      slab_indices[slab]);
+            std::swap(bottom, top);
+        }
+    });
 
-                    case 245:
-                        FACE(1, 5, 9);
-                        FACE(5, 11, 9);
-                        FACE(11, 3, 9);
-                        FACE(9, 3, 0);
-                        break;
+    auto num_faces = 0;
+    auto num_indices = 0ul;
+    for (auto slab = 0; slab < num_slabs; slab++) {
+        num_faces += slab_num_faces[slab];
+        num_indices += slab_indices[slab].size();
+    }
+    indices.reserve(num_indices);
+    for (auto &out : slab_indices) {
+        indices.insert(indices.end(), out.begin(), out.end());
+        std::vector<std::uint32_t>().swap(out);
+    }
+    stages.push_back(triangulation_timer.stop("triangulation", indices.size() / 3));
+    HOPPE_LOG("Marching cubes done. Potential faces: %d, vertices: %lu, triangles: %lu",
+              num_faces, vertices.size(), indices.size() / 3);
+}
 
-                    case 246:
-                        FACE(8, 0, 2);
-                        FACE(11, 8, 2);
-                        break;
+auto CubeMarcher::march_sparse(std::function<std::optional<float> (cv::Point3f)> sdf,
+                               cv::Point3f offset) -> void {
+    constexpr auto bits = BrickGrid<float>::bits;
+    constexpr auto width = BrickGrid<float>::width;
+    constexpr auto volume = BrickGrid<float>::volume;
+    constexpr auto edge_words = volume * 3 / 64;
+    const auto num_bricks = sdf_bricks.num_bricks();
+    vertices.clear();
+    indices.clear();
+    if (num_bricks == 0 || size(0) < 2 || size(1) < 2 || size(2) < 2) {
+        HOPPE_LOG("WARNING! Nothing to march: %lu bricks, grid %d %d %d",
+                  num_bricks, size(0), size(1), size(2));
+        return;
+    }
 
-                    case 247:
-                        FACE(3, 2, 11);
-                        break;
+    // Bricks near dense parts of the band cost far more than the others,
+    // so they go out in small chunks for idle threads to steal
+    auto &pool = thread_pool();
+    const auto brick_grain = (std::size_t) 8;
+    const auto num_chunks = ThreadPool::num_chunks(num_bricks, brick_grain);
+    const auto run_parallel = [&] (const std::function<void(std::size_t, std::size_t, std::size_t)> &func) {
+        pool.parallel_for(num_bricks, brick_grain, [&] (std::size_t begin, std::size_t end) {
+            func(begin / brick_grain, begin, end);
+        });
+    };
+    const auto brick_origin = [&] (std::size_t b) {
+        return cv::Vec3i(sdf_bricks.coords[b](0) << bits,
+                         sdf_bricks.coords[b](1) << bits,
+                         sdf_bricks.coords[b](2) << bits);
+    };
+    HOPPE_LOG("Marching %lu bricks on %u threads", num_bricks, pool.size());
+
+    // Evaluate the SDF at the band vertices; the rest keep the +1 background
+    const StageTimer sdf_timer;
+    std::vector<std::size_t> chunk_queries(num_chunks, 0);
+    run_parallel([&] (std::size_t c, std::size_t begin, std::size_t end) {
+        auto queries = 0ul;
+        for (auto b = begin; b < end; b++) {
+            const auto origin = brick_origin(b);
+            auto *values = sdf_bricks.brick(b);
+            const auto *in_band = &band_bricks[b * volume];
+            for (auto l = 0; l < volume; l++) {
+                if (in_band[l] == 0) {
+                    continue;
+                }
+                const auto x = origin(0) + (l & (width - 1));
+                const auto y = origin(1) + ((l >> bits) & (width - 1));
+                const auto z = origin(2) + (l >> (2 * bits));
+                const auto dist_sdf = sdf(offset + cv::Point3f(x * resolution, y * resolution, z * resolution));
+                values[l] = dist_sdf.has_value() ? dist_sdf.value() : 1.0f;
+                queries++;
+            }
+        }
+        chunk_queries[c] = queries;
+    });
+    stages.push_back(sdf_timer.stop("sdf", std::accumulate(chunk_queries.begin(), chunk_queries.end(), 0ul)));
+    const StageTimer triangulation_timer;
+
+    // Cells and edges reach one vertex into the bricks at +x, +y and +z.
+    // Entry n is the brick offset by (n & 1, n >> 1 & 1, n >> 2), or -1.
+    std::vector<std::array<std::int64_t, 8> > neighbors(num_bricks);
+    run_parallel([&] (std::size_t, std::size_t begin, std::size_t end) {
+        for (auto b = begin; b < end; b++) {
+            const auto &c = sdf_bricks.coords[b];
+            for (auto n = 0; n < 8; n++) {
+                neighbors[b][n] = sdf_bricks.find(c(0) + (n & 1), c(1) + ((n >> 1) & 1), c(2) + (n >> 2));
+            }
+        }
+    });
+    // Local coordinates run from 0 to width, where width is the next brick
+    const auto neighbor_of = [&] (std::size_t b, int lx, int ly, int lz) {
+        return neighbors[b][(lx >> bits) | ((ly >> bits) << 1) | ((lz >> bits) << 2)];
+    };
+    const auto value_at = [&] (std::size_t b, int lx, int ly, int lz) {
+        const auto nb = neighbor_of(b, lx, ly, lz);
+        return nb < 0 ? 1.0f : sdf_bricks.brick(nb)[BrickGrid<float>::local_index(lx, ly, lz)];
+    };
 
-                    case 248:
-                        FACE(8, 9, 10);
-                        FACE(8, 10, 2);
-                        FACE(3, 8, 2);
-                        break;
+    // Every brick owns the edges leaving its vertices towards +x, +y and +z.
+    // Crossing edges are kept as a bitset over (vertex, axis) along with the
+    // id of the first crossing in every word, so an edge id is one popcount.
+    struct BrickEdges {
+        std::uint64_t crossing[edge_words];
+        std::uint32_t first_id[edge_words];
+    };
+    std::vector<BrickEdges> edges(num_bricks);
+    std::vector<std::uint32_t> brick_base(num_bricks + 1, 0);
+    run_parallel([&] (std::size_t, std::size_t begin, std::size_t end) {
+        for (auto b = begin; b < end; b++) {
+            const auto origin = brick_origin(b);
+            const auto *values = sdf_bricks.brick(b);
+            auto &brick_edges = edges[b];
+            std::fill(std::begin(brick_edges.crossing), std::end(brick_edges.crossing), 0ull);
+            for (auto l = 0; l < volume; l++) {
+                const cv::Vec3i local(l & (width - 1), (l >> bits) & (width - 1), l >> (2 * bits));
+                const auto inside = values[l] < 0;
+                for (auto axis = 0; axis < 3; axis++) {
+                    if (origin(axis) + local(axis) + 1 >= size(axis)) {
+                        continue;
+                    }
+                    auto next = local;
+                    next(axis)++;
+                    if ((value_at(b, next(0), next(1), next(2)) < 0) != inside) {
+                        const auto bit = l * 3 + axis;
+                        brick_edges.crossing[bit >> 6] |= 1ull << (bit & 63);
+                    }
+                }
+            }
+            auto count = 0u;
+            for (auto w = 0; w < edge_words; w++) {
+                brick_edges.first_id[w] = count;
+                count += __builtin_popcountll(brick_edges.crossing[w]);
+            }
+            brick_base[b + 1] = count;
+        }
+    });
+    std::partial_sum(brick_base.begin(), brick_base.end(), brick_base.begin());
+    vertices.resize(brick_base[num_bricks]);
+
+    const cv::Point3f axis_offset[3] = {
+        { resolution * 0.5f, 0.0f, 0.0f },
+        { 0.0f, resolution * 0.5f, 0.0f },
+        { 0.0f, 0.0f, resolution * 0.5f }
+    };
+    run_parallel([&] (std::size_t, std::size_t begin, std::size_t end) {
+        for (auto b = begin; b < end; b++) {
+            const auto origin = brick_origin(b);
+            auto &brick_edges = edges[b];
+            for (auto w = 0; w < edge_words; w++) {
+                brick_edges.first_id[w] += brick_base[b];
+                auto id = brick_edges.first_id[w];
+                for (auto word = brick_edges.crossing[w]; word != 0; word &= word - 1) {
+                    const auto bit = w * 64 + __builtin_ctzll(word);
+                    const auto l = bit / 3;
+                    const auto x = origin(0) + (l & (width - 1));
+                    const auto y = origin(1) + ((l >> bits) & (width - 1));
+                    const auto z = origin(2) + (l >> (2 * bits));
+                    vertices[id++] = offset + cv::Point3f(x * resolution, y * resolution, z * resolution) + axis_offset[bit % 3];
+                }
+            }
+        }
+    });
+    const auto edge_id = [&] (std::size_t b, int lx, int ly, int lz, int axis) {
+        // The band allocation guarantees the owner of a crossing edge exists
+        const auto &owner = edges[neighbor_of(b, lx, ly, lz)];
+        const auto bit = BrickGrid<float>::local_index(lx, ly, lz) * 3 + axis;
+        return owner.first_id[bit >> 6] +
+            (std::uint32_t) __builtin_popcountll(owner.crossing[bit >> 6] & ((1ull << (bit & 63)) - 1));
+    };
 
-                    case 249:
-                        FACE(0, 9, 10);
-                        FACE(2, 0, 10);
-                        break;
+    // Triangulate the cells whose lower corner lies in each brick
+    std::vector<std::vector<std::uint32_t> > chunk_indices(num_chunks);
+    std::vector<int> chunk_num_faces(num_chunks, 0);
+    run_parallel([&] (std::size_t c, std::size_t begin, std::size_t end) {
+        auto &out = chunk_indices[c];
+        for (auto b = begin; b < end; b++) {
+            const auto origin = brick_origin(b);
+            for (auto l = 0; l < volume; l++) {
+                const auto lx = l & (width - 1), ly = (l >> bits) & (width - 1), lz = l >> (2 * bits);
+                if (origin(0) + lx >= size(0) - 1 || origin(1) + ly >= size(1) - 1 || origin(2) + lz >= size(2) - 1) {
+                    continue;
+                }
+                auto state = 0;
+                for (auto i = 0; i < 8; i++) {
+                    state |= (value_at(b, lx + corner_offsets[i][0],
+                                          ly + corner_offsets[i][1],
+                                          lz + corner_offsets[i][2]) < 0) << i;
+                }
+                // Corners outside the surface set the bits
+                state = ~state & 0xff;
+                if (state == 0 || state == 255) {
+                    continue;
+                }
+                chunk_num_faces[c]++;
 
-                    case 250:
-                        FACE(0, 4, 8);
-                        FACE(4, 10, 8);
-                        FACE(10, 2, 8);
-                        FACE(8, 2, 3);
-                        break;
+                const auto *triangles = triangle_table[state];
+                for (auto i = 0; triangles[i] != -1; i++) {
+                    const auto &slot = edge_slots[triangles[i]];
+                    out.push_back(edge_id(b, lx + slot.dx, ly + slot.dy, lz + slot.dz, slot.axis));
+                }
+            }
+        }
+    });
 
-                    case 251:
-                        FACE(2, 1, 10);
-                        break;
+    HOPPE_LOG("Sparse grid memory: %.2f MB for %lu bricks (dense grid would take %.2f MB)",
+              (sdf_bricks.memory_footprint() + band_bricks.capacity() +
+               edges.capacity() * sizeof(BrickEdges) + neighbors.capacity() * sizeof(neighbors[0])) / 1048576.0,
+              num_bricks, (double) size(0) * size(1) * size(2) * (sizeof(float) + 2) / 1048576.0);
 
-                    case 252:
-                        FACE(9, 1, 3);
-                        FACE(8, 9, 3);
-                        break;
+    auto num_faces = 0;
+    auto num_indices = 0ul;
+    for (auto c = 0ul; c < num_chunks; c++) {
+        num_faces += chunk_num_faces[c];
+        num_indices += chunk_indices[c].size();
+    }
+    indices.reserve(num_indices);
+    for (auto &out : chunk_indices) {
+        indices.insert(indices.end(), out.begin(), out.end());
+        std::vector<std::uint32_t>().swap(out);
+    }
+    stages.push_back(triangulation_timer.stop("triangulation", indices.size() / 3));
+    HOPPE_LOG("Marching cubes done. Potential faces: %d, vertices: %lu, triangles: %lu",
+              num_faces, vertices.size(), indices.size() / 3);
+}
 
-                    case 253:
-                        FACE(0, 9, 1);
-                        break;
+auto CubeMarcher::march_streaming(std::function<std::optional<float> (cv::Point3f)> sdf,
+                                  cv::Point3f offset,
+                                  const MeshSink &sink) -> void {
+    vertices.clear();
+    indices.clear();
+    if (size(0) < 2 || size(1) < 2 || size(2) < 2) {
+        HOPPE_LOG("WARNING! Marching grid too small: %d %d %d", size(0), size(1), size(2));
+        return;
+    }
+    const auto nx = size(0), ny = size(1), nz = size(2);
+    const auto plane_size = (std::size_t) nx * ny;
+    // Every chunk of rows walks the band window, so a few chunks per thread
+    auto &pool = thread_pool();
+    const auto row_grain = pool.grain(ny);
+    const auto num_chunks = ThreadPool::num_chunks(ny, row_grain);
+    const auto run_parallel = [&] (const std::function<void(std::size_t, int, int)> &func) {
+        pool.parallel_for(ny, row_grain, [&] (std::size_t begin, std::size_t end) {
+            func(begin / row_grain, (int) begin, (int) end);
+        });
+    };
 
-                    case 254:
-                        FACE(8, 0, 3);
-                        break;
-                        
-                    default:
-                        HOPPE_LOG("ERR! Unknown state: %d", cell.state);
-                        break;
+    // The sweep only ever holds the planes below and above the current layer
+    std::vector<float> lower(plane_size), upper(plane_size);
+    std::vector<std::uint8_t> plane_band(band_centers.empty() ? 0 : plane_size);
+    std::vector<std::uint32_t> lower_ids(plane_size * 2), upper_ids(plane_size * 2), z_ids(plane_size);
+    HOPPE_LOG("Streaming %d planes of %d x %d vertices, grid memory %.2f MB", nz, nx, ny,
+              (plane_size * (2 * sizeof(float) + 5 * sizeof(std::uint32_t)) + plane_band.size()) / 1048576.0);
+
+    // Band centers reach the planes cz - reach to cz + reach + 1, like in
+    // set_band. Sorted by z, the centers reaching a plane form a window
+    // that only slides forward during the sweep.
+    const auto squared_radius = band_radius * band_radius;
+    const auto reach = (int) ceilf(band_radius / resolution);
+    const auto center_plane = [&] (const cv::Point3f &center) {
+        return (int) floorf((center.z - offset.z) / resolution);
+    };
+    auto window_begin = 0ul, window_end = 0ul;
+
+    // Both stages run once per layer, so their pieces add up
+    StageReport sdf_stage, triangulation_stage;
+    sdf_stage.name = "sdf";
+    triangulation_stage.name = "triangulation";
+    std::vector<std::size_t> chunk_queries(num_chunks, 0);
+
+    const auto evaluate_plane = [&] (int z, float *values) {
+        const StageTimer sdf_timer;
+        if (!plane_band.empty()) {
+            while (window_end < band_centers.size() && center_plane(band_centers[window_end]) <= z + reach) {
+                window_end++;
+            }
+            while (window_begin < window_end && center_plane(band_centers[window_begin]) + reach + 1 < z) {
+                window_begin++;
+            }
+        }
+        run_parallel([&] (std::size_t c, int y_begin, int y_end) {
+            if (!plane_band.empty()) {
+                std::fill(plane_band.begin() + (std::size_t) y_begin * nx,
+                          plane_band.begin() + (std::size_t) y_end * nx, 0);
+                for (auto i = window_begin; i < window_end; i++) {
+                    const auto &center = band_centers[i];
+                    const auto local = (center - offset) / resolution;
+                    const auto cx = (int) floorf(local.x), cy = (int) floorf(local.y);
+                    const auto y_min = std::max(y_begin, cy - reach), y_max = std::min(y_end - 1, cy + reach + 1);
+                    const auto x_min = std::max(0, cx - reach), x_max = std::min(nx - 1, cx + reach + 1);
+                    for (auto y = y_min; y <= y_max; y++) {
+                        for (auto x = x_min; x <= x_max; x++) {
+                            const auto d = offset + cv::Point3f(x * resolution, y * resolution, z * resolution) - center;
+                            if (d.dot(d) <= squared_radius) {
+                                plane_band[(std::size_t) y * nx + x] = 1;
+                            }
+                        }
+                    }
                 }
-                face_mutex.unlock();
             }
-        };
-        threads.push_back(std::thread(march));
-    }
-    for (auto &t : threads) {
-        t.join();
+            auto queries = 0ul;
+            for (auto y = y_begin; y < y_end; y++) {
+                for (auto x = 0; x < nx; x++) {
+                    const auto v = (std::size_t) y * nx + x;
+                    if (!plane_band.empty() && plane_band[v] == 0) {
+                        values[v] = 1.0f;
+                        continue;
+                    }
+                    const auto dist_sdf = sdf(offset + cv::Point3f(x * resolution, y * resolution, z * resolution));
+                    values[v] = dist_sdf.has_value() ? dist_sdf.value() : 1.0f;
+                    queries++;
+                }
+            }
+            chunk_queries[c] += queries;
+        });
+        sdf_timer.stop(sdf_stage, 0);
+    };
+
+    // Vertices are numbered in the same order as on a dense grid, so the
+    // streamed mesh matches the dense one chunk after chunk.
+    const cv::Point3f axis_offset[3] = {
+        { resolution * 0.5f, 0.0f, 0.0f },
+        { 0.0f, resolution * 0.5f, 0.0f },
+        { 0.0f, 0.0f, resolution * 0.5f }
+    };
+    std::vector<cv::Point3f> chunk_vertices;
+    std::vector<std::uint32_t> chunk_indices;
+    std::vector<std::vector<std::uint32_t> > chunk_layer_indices(num_chunks);
+    std::vector<int> chunk_num_faces(num_chunks, 0);
+    auto next_id = 0u;
+    auto vertex_z = 0;
+    const auto emit = [&] (int x, int y, int axis, std::uint32_t) {
+        chunk_vertices.push_back(offset + cv::Point3f(x * resolution, y * resolution, vertex_z * resolution) + axis_offset[axis]);
+    };
+    auto num_indices = 0ul;
+
+    evaluate_plane(0, &lower[0]);
+    number_plane_edges(&lower[0], nx, ny, &lower_ids[0], next_id, emit);
+    for (auto z = 0; z < nz - 1; z++) {
+        evaluate_plane(z + 1, &upper[0]);
+        // Includes handing the layer to the sink, which blocks while its queue is full
+        const StageTimer triangulation_timer;
+        vertex_z = z;
+        number_z_edges(&lower[0], &upper[0], nx, ny, &z_ids[0], next_id, emit);
+        vertex_z = z + 1;
+        number_plane_edges(&upper[0], nx, ny, &upper_ids[0], next_id, emit);
+
+        run_parallel([&] (std::size_t c, int y_begin, int y_end) {
+            chunk_num_faces[c] += triangulate_layer(&lower[0], &upper[0], nx, ny,
+                                                     y_begin, std::min(y_end, ny - 1),
+                                                     &lower_ids[0], &upper_ids[0], &z_ids[0],
+                                                    nullptr, chunk_layer_indices[c]);
+        });
+        for (auto &out : chunk_layer_indices) {
+            chunk_indices.insert(chunk_indices.end(), out.begin(), out.end());
+            out.clear();
+        }
+
+        num_indices += chunk_indices.size();
+        if (sink) {
+            sink(std::move(chunk_vertices), std::move(chunk_indices));
+        } else {
+            vertices.insert(vertices.end(), chunk_vertices.begin(), chunk_vertices.end());
+            indices.insert(indices.end(), chunk_indices.begin(), chunk_indices.end());
+        }
+        chunk_vertices.clear();
+        chunk_indices.clear();
+        std::swap(lower, upper);
+        std::swap(lower_ids, upper_ids);
+        triangulation_timer.stop(triangulation_stage, 0);
     }
-    HOPPE_LOG("Marching cubes done. Potential faces: %d", num_faces);
+    sdf_stage.items = std::accumulate(chunk_queries.begin(), chunk_queries.end(), 0ul);
+    triangulation_stage.items = num_indices / 3;
+    stages.push_back(sdf_stage);
+    stages.push_back(triangulation_stage);
+
+    const auto num_faces = std::accumulate(chunk_num_faces.begin(), chunk_num_faces.end(), 0);
+    HOPPE_LOG("Marching cubes done. Potential faces: %d, vertices: %u, triangles: %lu",
+              num_faces, next_id, num_indices / 3);
 }
 
 auto CubeMarcher::dump(std::string to) -> void { 
+    if (mode != GridMode::dense) {
+        HOPPE_LOG("WARNING! Dumping is only supported for dense grids.");
+        return;
+    }
     HOPPE_LOG("Dumping file to %s...", to.c_str());
     
     std::ofstream ofs(to);
-    for (auto z = 0; z < cell_mat.size(); z++) {
-        for (auto y = 0; y < cell_mat.size(); y++) {
-            for (auto x = 0; x < cell_mat.size(); x++) {
-                const auto &cell = cell_mat[z][y][x];
-                if (cell.state == 0 || cell.state == 255) {
+    for (auto z = 0; z < size(2) - 1; z++) {
+        for (auto y = 0; y < size(1) - 1; y++) {
+            for (auto x = 0; x < size(0) - 1; x++) {
+                const auto state = cell_mat(x, y, z);
+                if (state == 0 || state == 255) {
                     continue;
                 }
-                ofs << x << ", " << y << ", " << z << " - " << cell.state << " [";
+                ofs << x << ", " << y << ", " << z << " - " << (int) state << " [";
                 for (auto i = 0; i < 8; i++) {
-                    ofs << cell.values[i];
+                    ofs << sdf_grid(x + corner_offsets[i][0],
+                                    y + corner_offsets[i][1],
+                                    z + corner_offsets[i][2]);
                     if (i != 7) {
                         ofs << ", ";
                     }
@@ -1762,4 +915,3 @@ auto CubeMarcher::dump(std::string to) -> void {
     }
     ofs.close();
 }
-
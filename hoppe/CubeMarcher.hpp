@@ -13,7 +13,13 @@
 #include <functional>
 #include <optional>
 #include <map>
+#include <unordered_map>
+#include <new>
+#include <cstdint>
+#include <memory>
 #include "hoppe_common.hpp"
+#include "Instrumentation.hpp"
+#include "ThreadPool.hpp"
 
 
 struct Cell {
@@ -23,43 +29,255 @@ public:
     int state;
 };
 
-struct Triangle {
-    cv::Point3f points[3];
-    
-    auto operator+(const cv::Point3f offset) -> Triangle {
-        return Triangle { points[0] + offset,
-                          points[1] + offset,
-                          points[2] + offset };
+
+/// Allocator handing out cache line aligned storage.
+template<typename T>
+struct CacheAlignedAllocator {
+    typedef T value_type;
+
+    static constexpr std::size_t alignment = 64;
+
+    CacheAlignedAllocator() = default;
+
+    template<typename U>
+    CacheAlignedAllocator(const CacheAlignedAllocator<U> &) {}
+
+    auto allocate(std::size_t n) -> T * {
+        return (T *) ::operator new(n * sizeof(T), std::align_val_t(alignment));
+    }
+
+    auto deallocate(T *p, std::size_t) -> void {
+        ::operator delete(p, std::align_val_t(alignment));
     }
+
+    template<typename U>
+    auto operator==(const CacheAlignedAllocator<U> &) const -> bool { return true; }
+
+    template<typename U>
+    auto operator!=(const CacheAlignedAllocator<U> &) const -> bool { return false; }
 };
 
-typedef std::vector<std::vector<std::vector<Cell> > > CellMat;
+/// Dense 3D grid kept in a single flat, cache line aligned buffer.
+/// x varies fastest, then y, then z.
+template<typename T>
+class FlatGrid {
+public:
+    auto resize(cv::Vec3i size, T value = T()) -> void {
+        this->size = size;
+        data.assign((std::size_t) size(0) * size(1) * size(2), value);
+    }
+
+    inline auto index(int x, int y, int z) const -> std::size_t {
+        return ((std::size_t) z * size(1) + y) * size(0) + x;
+    }
+
+    inline auto operator()(int x, int y, int z) -> T & {
+        return data[index(x, y, z)];
+    }
+
+    inline auto operator()(int x, int y, int z) const -> const T & {
+        return data[index(x, y, z)];
+    }
+
+    auto memory_footprint() const -> std::size_t {
+        return data.capacity() * sizeof(T);
+    }
+
+    std::vector<T, CacheAlignedAllocator<T> > data;
+    cv::Vec3i size;
+};
+
+/// Sparse 3D grid made of 8x8x8 bricks, allocated on demand and found
+/// through a hash map. Brick values are stored back to back, each brick
+/// laid out like a small FlatGrid.
+template<typename T>
+class BrickGrid {
+public:
+    static constexpr int bits = 3;
+    static constexpr int width = 1 << bits;
+    static constexpr int volume = width * width * width;
+
+    /// Drops all bricks and releases their memory.
+    auto clear() -> void {
+        decltype(values)().swap(values);
+        decltype(coords)().swap(coords);
+        decltype(lookup)().swap(lookup);
+    }
+
+    /// Allocates one brick per coordinate, in the given order.
+    /// @param brick_coords brick coordinates, i.e. vertex coordinates >> bits
+    /// @param value initial value of every vertex
+    auto allocate(const std::vector<cv::Vec3i> &brick_coords, T value) -> void {
+        clear();
+        coords = brick_coords;
+        values.assign(coords.size() * volume, value);
+        lookup.reserve(coords.size());
+        for (auto b = 0u; b < coords.size(); b++) {
+            lookup[key(coords[b](0), coords[b](1), coords[b](2))] = b;
+        }
+    }
+
+    static inline auto key(int bx, int by, int bz) -> std::uint64_t {
+        return ((std::uint64_t) bz << 42) | ((std::uint64_t) by << 21) | (std::uint64_t) bx;
+    }
+
+    static inline auto local_index(int x, int y, int z) -> int {
+        return (x & (width - 1)) | ((y & (width - 1)) << bits) | ((z & (width - 1)) << (2 * bits));
+    }
+
+    /// @returns index of the brick, or -1 if it is not allocated
+    inline auto find(int bx, int by, int bz) const -> std::int64_t {
+        const auto it = lookup.find(key(bx, by, bz));
+        return it == lookup.end() ? -1 : (std::int64_t) it->second;
+    }
+
+    inline auto brick(std::size_t b) -> T * {
+        return &values[b * volume];
+    }
+
+    inline auto brick(std::size_t b) const -> const T * {
+        return &values[b * volume];
+    }
+
+    inline auto num_bricks() const -> std::size_t {
+        return coords.size();
+    }
+
+    auto memory_footprint() const -> std::size_t {
+        return values.capacity() * sizeof(T) + coords.capacity() * sizeof(cv::Vec3i) +
+            lookup.bucket_count() * sizeof(void *) +
+            lookup.size() * (sizeof(std::pair<std::uint64_t, std::uint32_t>) + 2 * sizeof(void *));
+    }
+
+    std::vector<T, CacheAlignedAllocator<T> > values;
+    std::vector<cv::Vec3i> coords;
+
+private:
+    std::unordered_map<std::uint64_t, std::uint32_t> lookup;
+};
+
+// Cell states only; corner values live in the SDF grid
+typedef FlatGrid<std::uint8_t> CellMat;
+
+/// Receives a mesh chunk by chunk: the vertices new to this chunk, whose ids
+/// continue where the previous chunk stopped, and three vertex ids per
+/// triangle. Triangles only use vertices of this or the previous chunk.
+/// The sink may take both vectors over.
+typedef std::function<void(std::vector<cv::Point3f> &&vertices,
+                           std::vector<std::uint32_t> &&indices)> MeshSink;
 
 /// Implements the Marching Cube algorithm.
 class CubeMarcher {
 public:
     CubeMarcher() {}
     
-    CubeMarcher(cv::Vec3i size, float resolution) {
-        init(size, resolution);
+    CubeMarcher(cv::Vec3i size, float resolution, GridMode mode = GridMode::dense) {
+        init(size, resolution, mode);
     }
     
-    auto init(cv::Vec3i size, float resolution) -> void;
+    /// @param size number of grid vertices along every axis
+    /// @param resolution distance between neighboring grid vertices
+    /// @param mode how to keep the grid in memory. Sparse grids only march
+    ///     where `set_band` put vertices.
+    auto init(cv::Vec3i size, float resolution, GridMode mode = GridMode::dense) -> void;
     
+    /// Restricts SDF evaluation to the grid vertices within `radius` of any
+    /// of `centers`. Every other vertex counts as outside the surface, so
+    /// the work follows the surface area instead of the grid volume.
+    /// Must be called after `init`, which clears the band.
+    /// @param centers band centers in world space
+    /// @param radius band radius around every center
+    /// @param offset world position of grid vertex (0, 0, 0)
+    /// @param max_vertices sparse grids allocate nothing when their bricks
+    ///     would hold more vertices than this
+    /// @returns false if the sparse grid went over `max_vertices`
+    auto set_band(const std::vector<cv::Point3f> &centers,
+                  float radius,
+                  cv::Point3f offset,
+                  std::size_t max_vertices = SIZE_MAX) -> bool;
+
+    /// Counts the bricks holding at least one of `centers`, a cheap lower
+    /// bound on the bricks a sparse `set_band` allocates at `resolution`.
+    /// @param centers band centers in world space
+    /// @param resolution distance between neighboring grid vertices
+    /// @param offset world position of grid vertex (0, 0, 0)
+    static auto count_center_bricks(const std::vector<cv::Point3f> &centers,
+                                    float resolution,
+                                    cv::Point3f offset) -> std::size_t;
+
+    /// Marches the grid. The mesh ends up in `vertices` and `indices`,
+    /// unless a sink is given: streaming grids then hand it over one z layer
+    /// at a time, the others hand it over as a single chunk at the end.
+    /// @param sdf signed distance function, empty outside its support
+    /// @param offset world position of grid vertex (0, 0, 0)
+    /// @param sink receives the mesh instead of `vertices` and `indices`
     auto march(std::function<std::optional<float>(cv::Point3f)> sdf,
-               cv::Point3f offset) -> void;
+               cv::Point3f offset,
+               MeshSink sink = nullptr) -> void;
+
+    /// Number of grid vertices backed by memory: the whole volume for dense
+    /// grids, the allocated bricks for sparse ones and two planes when streaming.
+    auto stored_vertices() const -> std::size_t;
+
+    /// Runs the parallel parts on `pool` instead of a pool of our own.
+    /// @param pool pool outliving the marcher, or nullptr to use our own
+    auto use_pool(ThreadPool *pool) -> void;
     
     
     /// For debugging purposes only
     /// @param to dump to which path
     auto dump(std::string to) -> void;
     
-    std::vector<Triangle> faces;
+    /// Welded output mesh: every grid edge crossing the surface yields one vertex.
+    std::vector<cv::Point3f> vertices;
+
+    /// Three vertex indices per triangle.
+    std::vector<std::uint32_t> indices;
+
+    /// Resources the last `march` spent on "sdf" evaluation, counted in
+    /// queries, and on "triangulation", counted in triangles.
+    std::vector<StageReport> stages;
 
 private:
+    /// Pool given to `use_pool`, else our own, started on first use.
+    auto thread_pool() -> ThreadPool &;
+
+    auto set_band_sparse(const std::vector<cv::Point3f> &centers,
+                         float radius,
+                         cv::Point3f offset,
+                         std::size_t max_vertices) -> bool;
+
+    auto march_dense(std::function<std::optional<float>(cv::Point3f)> sdf,
+                     cv::Point3f offset) -> void;
+
+    auto march_sparse(std::function<std::optional<float>(cv::Point3f)> sdf,
+                      cv::Point3f offset) -> void;
+
+    auto march_streaming(std::function<std::optional<float>(cv::Point3f)> sdf,
+                         cv::Point3f offset,
+                         const MeshSink &sink) -> void;
+
     CellMat cell_mat;
+    FlatGrid<float> sdf_grid;
+
+    // Vertices to evaluate; empty when the whole grid is marched
+    FlatGrid<std::uint8_t> band;
+
+    GridMode mode = GridMode::dense;
+
+    // Sparse backend: SDF values and band flags share the brick layout
+    BrickGrid<float> sdf_bricks;
+    std::vector<std::uint8_t> band_bricks;
+
+    // Streaming backend splats the band one plane at a time from centers
+    // sorted by z
+    std::vector<cv::Point3f> band_centers;
+    float band_radius = 0.0f;
     cv::Vec3i size;
     float resolution;
+
+    ThreadPool *pool = nullptr;
+    std::unique_ptr<ThreadPool> own_pool;
 };
 
 #endif /* CubeMarcher_hpp */
@@ -7,127 +7,404 @@
 
 #include "Hoppe.hpp"
 #include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <numeric>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <thread>
 #include <mutex>
+#include <chrono>
 #include <iostream>
 #include "UGraph.hpp"
+#include "NormalSolver.hpp"
+#include "MeshWriter.hpp"
+#include "PointCloudCache.hpp"
+#include "MortonOrder.hpp"
 
 
-auto Hoppe::run() -> bool {
+auto Hoppe::run() -> RunReport {
+    report = RunReport();
+    if (!load_stage.name.empty()) {
+        report.stages.push_back(load_stage);
+    }
     if (pointcloud.points.size() == 0) {
         HOPPE_LOG("ERR! Can't run without point cloud");
-        return false;
+        return report;
     }
 
-    estimate_planes();
+    // Planes loaded from a cache are reused as long as k did not change
+    if (plane_settings != PlaneSettings::of(parameters)) {
+        if (parameters.spatial_order) {
+            sort_spatially();
+        }
+        estimate_planes();
 
-    fix_orientations();
+        fix_orientations();
+        plane_settings = PlaneSettings::of(parameters);
 
-    export_to_ply("planecloud.ply");
+        export_to_ply("planecloud.ply");
+    }
     
     cube_march();
 
+    report.success = true;
+    report.log();
+    if (!report_output.empty()) {
+        report.write_json(report_output);
+    }
+    return report;
+}
+
+/// Advances `it` past spaces, tabs and carriage returns, but not past newlines.
+static auto skip_blanks(const char *it, const char *end) -> const char * {
+    while (it < end && (*it == ' ' || *it == '\t' || *it == '\r')) {
+        it++;
+    }
+    return it;
+}
+
+/// Moves a chunk boundary forward so it sits right after a newline.
+static auto align_to_line(const char *begin, const char *it, const char *end) -> const char * {
+    if (it == begin) {
+        return it;
+    }
+    while (it < end && *(it - 1) != '\n') {
+        it++;
+    }
+    return it;
+}
+
+/// Counts lines in [begin, end) that carry any content.
+/// @param lines receives the number of newlines in [begin, end)
+static auto count_records(const char *begin, const char *end, std::size_t &lines) -> std::size_t {
+    auto count = 0ul;
+    lines = 0;
+    auto it = begin;
+    while (it < end) {
+        it = skip_blanks(it, end);
+        const auto line_end = std::find(it, end, '\n');
+        if (it != line_end) {
+            count++;
+        }
+        if (line_end < end) {
+            lines++;
+        }
+        it = line_end + (line_end < end ? 1 : 0);
+    }
+    return count;
+}
+
+/// Parses the number at `it`, which runs up to the next blank, and moves
+/// `it` past it. strtof needs a terminated string, so the number is copied
+/// out of the file first.
+/// @returns false if the text there is not a number
+static auto parse_float(const char *&it, const char *line_end, float &value) -> bool {
+    auto token_end = it;
+    while (token_end < line_end && *token_end != ' ' && *token_end != '\t' && *token_end != '\r') {
+        token_end++;
+    }
+    char buffer[64];
+    const auto length = (std::size_t) (token_end - it);
+    if (length == 0 || length >= sizeof(buffer)) {
+        return false;
+    }
+    std::memcpy(buffer, it, length);
+    buffer[length] = '\0';
+    char *parsed_end = nullptr;
+    value = strtof(buffer, &parsed_end);
+    if (parsed_end != buffer + length) {
+        return false;
+    }
+    it = token_end;
     return true;
 }
 
+/// Where parsing a chunk ran into trouble, in lines from the chunk start.
+struct ParseIssues {
+    // First line that is not three numbers, SIZE_MAX if there is none
+    std::size_t malformed_line = SIZE_MAX;
+    // Lines with text after the third number, and the first of them
+    std::size_t trailing_lines = 0;
+    std::size_t first_trailing_line = SIZE_MAX;
+};
+
+/// Parses "x y z" records in [begin, end) into `out`.
+/// @param issues receives malformed lines and lines with trailing text
+/// @returns number of records parsed, which stops at the first malformed line
+static auto parse_records(const char *begin, const char *end, cv::Point3f *out, ParseIssues &issues) -> std::size_t {
+    auto count = 0ul;
+    auto line = 0ul;
+    auto it = begin;
+    while (it < end) {
+        it = skip_blanks(it, end);
+        const auto line_end = std::find(it, end, '\n');
+        if (it != line_end) {
+            float values[3];
+            for (auto i = 0; i < 3; i++) {
+                it = skip_blanks(it, line_end);
+                if (!parse_float(it, line_end, values[i])) {
+                    issues.malformed_line = line;
+                    return count;
+                }
+            }
+            if (skip_blanks(it, line_end) != line_end) {
+                if (issues.trailing_lines++ == 0) {
+                    issues.first_trailing_line = line;
+                }
+            }
+            out[count++] = cv::Point3f(values[0], values[1], values[2]);
+        }
+        line++;
+        it = line_end + (line_end < end ? 1 : 0);
+    }
+    return count;
+}
+
 auto Hoppe::load_pointcloud(std::string path) -> void {
     HOPPE_LOG("Loading point cloud...");
-    std::ifstream reader(path);
-    
-    if (!reader.good()) {
+    const auto load_begin = std::chrono::steady_clock::now();
+    const StageTimer load_timer;
+    load_stage = StageReport();
+    pointcloud.points.clear();
+    original_order.clear();
+    point_index.reset();
+    std::vector<std::size_t>().swap(point_neighborhoods);
+    plane_settings = PlaneSettings();
+    source = CacheSource::of(path);
+
+    const auto fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
         HOPPE_LOG("WARNING! Bad reader: %s", path.c_str());
         return;
     }
-    pointcloud.points.clear();
-    while (!reader.eof()) {
-        cv::Point3f p;
-        reader >> p.x >> p.y >> p.z;
-        pointcloud.points.push_back(p);
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size <= 0) {
+        HOPPE_LOG("WARNING! Empty or unreadable file: %s", path.c_str());
+        close(fd);
+        return;
+    }
+    const auto file_size = (std::size_t) file_stat.st_size;
+    auto mapped = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        HOPPE_LOG("WARNING! Failed to map %s", path.c_str());
+        return;
+    }
+    madvise(mapped, file_size, MADV_SEQUENTIAL);
+    const auto data = (const char *) mapped;
+    const auto data_end = data + file_size;
+
+    // Split the file into chunks at line boundaries; a few per thread, so
+    // threads that hit short lines can take over, but at least 1MB each.
+    auto &pool = thread_pool();
+    const auto num_chunks = (int) std::max(1ul, std::min(pool.size() * 4ul, file_size >> 20));
+    std::vector<const char *> chunk_begins(num_chunks + 1);
+    for (auto i = 0; i < num_chunks; i++) {
+        chunk_begins[i] = align_to_line(data, data + file_size / num_chunks * i, data_end);
+    }
+    chunk_begins[num_chunks] = data_end;
+
+    // First pass counts records so every chunk knows where to write.
+    // Line counts turn chunk relative lines into file lines for warnings.
+    std::vector<std::size_t> chunk_offsets(num_chunks + 1, 0);
+    std::vector<std::size_t> chunk_lines(num_chunks + 1, 0);
+    std::vector<std::size_t> chunk_parsed(num_chunks, 0);
+    std::vector<ParseIssues> chunk_issues(num_chunks);
+    pool.parallel_for(num_chunks, 1, [&] (std::size_t i, std::size_t) {
+        chunk_offsets[i + 1] = count_records(chunk_begins[i], chunk_begins[i + 1], chunk_lines[i + 1]);
+    });
+    std::partial_sum(chunk_offsets.begin(), chunk_offsets.end(), chunk_offsets.begin());
+    std::partial_sum(chunk_lines.begin(), chunk_lines.end(), chunk_lines.begin());
+    pointcloud.points.resize(chunk_offsets[num_chunks]);
+
+    // Second pass parses straight into the point cloud.
+    pool.parallel_for(num_chunks, 1, [&] (std::size_t i, std::size_t) {
+        chunk_parsed[i] = parse_records(chunk_begins[i],
+                                        chunk_begins[i + 1],
+                                        pointcloud.points.data() + chunk_offsets[i],
+                                        chunk_issues[i]);
+    });
+    munmap(mapped, file_size);
+
+    // A malformed line fails the whole load instead of truncating the cloud
+    auto trailing_lines = 0ul, first_trailing_line = 0ul;
+    for (auto i = 0; i < num_chunks; i++) {
+        const auto &issues = chunk_issues[i];
+        if (issues.malformed_line != SIZE_MAX) {
+            HOPPE_LOG("ERR! Malformed line %lu in %s, expected three numbers",
+                      chunk_lines[i] + issues.malformed_line + 1, path.c_str());
+            pointcloud.points.clear();
+            return;
+        }
+        if (chunk_parsed[i] != chunk_offsets[i + 1] - chunk_offsets[i]) {
+            HOPPE_LOG("ERR! Parsed %lu records in lines %lu to %lu of %s, but counted %lu",
+                      chunk_parsed[i], chunk_lines[i] + 1, chunk_lines[i + 1], path.c_str(),
+                      chunk_offsets[i + 1] - chunk_offsets[i]);
+            pointcloud.points.clear();
+            return;
+        }
+        if (issues.trailing_lines > 0 && trailing_lines == 0) {
+            first_trailing_line = chunk_lines[i] + issues.first_trailing_line + 1;
+        }
+        trailing_lines += issues.trailing_lines;
+    }
+    if (trailing_lines > 0) {
+        HOPPE_LOG("WARNING! Ignored text after the third number on line %lu of %s, and on %lu more lines",
+                  first_trailing_line, path.c_str(), trailing_lines - 1);
     }
-    HOPPE_LOG("Point cloud loading done. Size: %lu", pointcloud.points.size());
+
+    load_stage = load_timer.stop("load", pointcloud.points.size());
+    const std::chrono::duration<double> load_time = std::chrono::steady_clock::now() - load_begin;
+    HOPPE_LOG("Point cloud loading done. Size: %lu, %f MB/s with %u threads",
+              pointcloud.points.size(),
+              file_size / 1048576.0 / load_time.count(),
+              pool.size());
+}
+
+auto Hoppe::set_pointcloud(std::vector<cv::Point3f> points) -> void {
+    const StageTimer load_timer;
+    pointcloud.points = std::move(points);
+    original_order.clear();
+    point_index.reset();
+    std::vector<std::size_t>().swap(point_neighborhoods);
+    plane_settings = PlaneSettings();
+    source = CacheSource();
+    load_stage = load_timer.stop("load", pointcloud.points.size());
+}
+
+auto Hoppe::sort_spatially() -> void {
+    const StageTimer timer;
+    const auto order = morton_order(pointcloud.points, thread_pool());
+    const auto num_points = order.size();
+
+    auto &pool = thread_pool();
+    const auto grain = pool.grain(num_points);
+    std::vector<cv::Point3f> sorted(num_points);
+    std::vector<std::size_t> sorted_original(num_points);
+    pool.parallel_for(num_points, grain, [&] (std::size_t begin, std::size_t end) {
+        for (auto i = begin; i < end; i++) {
+            sorted[i] = pointcloud.points[order[i]];
+            sorted_original[i] = original_order.empty() ? order[i] : original_order[order[i]];
+        }
+    });
+    pointcloud.points.swap(sorted);
+    original_order.swap(sorted_original);
+    // The tree indexes points by position
+    point_index.reset();
+
+    report.stages.push_back(timer.stop("spatial_order", num_points));
+    HOPPE_LOG("Spatial ordering done. Size: %lu", num_points);
 }
 
 auto Hoppe::estimate_planes() -> bool {
     HOPPE_LOG("Esimating tangent planes...");
+    const StageTimer timer;
     tangent_planes.planes.clear();
+    plane_index.reset();
+    std::vector<std::size_t>().swap(point_neighborhoods);
     
     if (parameters.k <= 1) {
         return false;
     }
     
-    // Build nearest neighbor tree
-    PointCloudIndex index(3, pointcloud, nanoflann::KDTreeSingleIndexAdaptorParams(10));
-    index.buildIndex();
+    plane_settings = PlaneSettings();
+    if (!point_index) {
+        build_point_index();
+    }
+    const auto &index = *point_index;
     
     const auto num_neighbors = parameters.k + 1; // Because it contains query point itself
     
-    for (auto i = 0; i < pointcloud.points.size(); i++) {
-        std::vector<std::size_t> indices(num_neighbors);
-        std::vector<float> out_squared_dist(num_neighbors);
-
-        const auto &p = pointcloud.points[i];
-        const auto nbhd_count = index.knnSearch(&p.x,
-                                                num_neighbors,
-                                                &indices[0],
-                                                &out_squared_dist[0]);
-        if (nbhd_count != num_neighbors) {
-            HOPPE_LOG("WARNING! Failed to find enough neighbors here: %lu != %d", nbhd_count, num_neighbors);
-        }
+    // Every plane only depends on its own neighborhood, so chunks write
+    // their results by index and the output matches the serial order.
+    // Chunks hold whole batches of the normal solver.
+    const auto num_points = pointcloud.points.size();
+    tangent_planes.planes.resize(num_points);
+    if (parameters.shared_knn) {
+        // Missing neighbors are marked with num_points
+        point_neighborhoods.assign(num_points * num_neighbors, num_points);
+    }
+    auto &pool = thread_pool();
+    const auto grain = (pool.grain(num_points) + HOPPE_NORMAL_BATCH - 1) / HOPPE_NORMAL_BATCH * HOPPE_NORMAL_BATCH;
+    std::mutex log_mutex;
+
+    pool.parallel_for(num_points, grain, [&] (std::size_t begin_index, std::size_t end_index) {
+        // One result buffer on this chunk's stack serves all of its queries
+        NeighborBuffer neighbors(num_neighbors);
+
+        for (auto batch_begin = begin_index; batch_begin < end_index; batch_begin += HOPPE_NORMAL_BATCH) {
+            const auto batch_size = std::min((std::size_t) HOPPE_NORMAL_BATCH, end_index - batch_begin);
+            cv::Matx33f covariances[HOPPE_NORMAL_BATCH];
+            NormalEstimate estimates[HOPPE_NORMAL_BATCH];
+
+            for (auto b = 0; b < batch_size; b++) {
+                const auto i = batch_begin + b;
+                const auto &p = pointcloud.points[i];
+                const auto indices = parameters.shared_knn ?
+                    &point_neighborhoods[i * num_neighbors] :
+                    neighbors.indices();
+                const auto nbhd_count = neighbors.knn(index, &p.x, num_neighbors, indices);
+                if (nbhd_count != num_neighbors) {
+                    log_mutex.lock();
+                    HOPPE_LOG("WARNING! Failed to find enough neighbors here: %lu != %d", nbhd_count, num_neighbors);
+                    log_mutex.unlock();
+                }
 
-        Plane plane;
+                // Calculate centroid
+                cv::Point3f centroid(0.0f, 0.0f, 0.0f);
+                for (auto j = 0; j < nbhd_count; j++) {
+                    const auto current_index = indices[j];
+                    if (current_index == i) {
+                        // That would be myself
+                        continue;
+                    }
+                    const auto neighbor = pointcloud.points[current_index];
+                    centroid += neighbor;
+                }
+                centroid /= (float) (nbhd_count - 1);
+                tangent_planes.planes[i].origin = centroid;
 
-        // Calculate centroid
-        cv::Point3f centroid(0.0f, 0.0f, 0.0f);
-        for (auto j = 0; j < nbhd_count; j++) {
-            const auto current_index = indices[j];
-            if (current_index == i) {
-                // That would be myself
-                continue;
-            }
-            const auto neighbor = pointcloud.points[current_index];
-            centroid += neighbor;
-        }
-        centroid /= (float) (nbhd_count - 1);
-        plane.origin = centroid;
-
-        // Calculate covariance matrix & normal
-        cv::Matx33f covariance_mat;
-        for (auto j = 0; j < nbhd_count; j++) {
-            const auto current_index = indices[j];
-            if (current_index == i) {
-                continue;
+                // Calculate covariance matrix
+                auto &covariance_mat = covariances[b];
+                for (auto j = 0; j < nbhd_count; j++) {
+                    const auto current_index = indices[j];
+                    if (current_index == i) {
+                        continue;
+                    }
+                    const auto neighbor = pointcloud.points[current_index];
+                    const auto oy = neighbor - centroid;
+                    const cv::Matx31f oy_mat = { oy.x, oy.y, oy.z };
+                    cv::Matx33f outer_product;
+                    cv::mulTransposed(oy_mat, outer_product, false);
+                    covariance_mat += outer_product;
+                }
             }
-            const auto neighbor = pointcloud.points[current_index];
-            const auto oy = neighbor - centroid;
-            const cv::Matx31f oy_mat = { oy.x, oy.y, oy.z };
-            cv::Matx33f outer_product;
-            cv::mulTransposed(oy_mat, outer_product, false);
-            covariance_mat += outer_product;
-        }
 
-        cv::Matx31f eigenvalues;
-        cv::Matx33f eigenvectors;
-        cv::eigen(covariance_mat, eigenvalues, eigenvectors);
-        auto min_idx = -1;
-        auto min_val = 0.0f;
-        for (auto i = 0; i < 3; i++) {
-            if (min_idx == -1 || eigenvalues(i, 0) < min_val) {
-                min_idx = i;
-                min_val = eigenvalues(i, 0);
+            // Normal is the eigenvector of the smallest eigenvalue
+#if HOPPE_REFERENCE_EIGEN
+            for (auto b = 0; b < batch_size; b++) {
+                estimates[b] = solve_normal_reference(covariances[b]);
+            }
+#else
+            solve_normals(covariances, batch_size, estimates);
+#endif
+            for (auto b = 0; b < batch_size; b++) {
+                tangent_planes.planes[batch_begin + b].normal = estimates[b].normal;
             }
         }
-        plane.normal = cv::normalize(cv::Vec3f(eigenvectors(min_idx, 0),
-                                               eigenvectors(min_idx, 1),
-                                               eigenvectors(min_idx, 2)));
-        tangent_planes.planes.push_back(plane);
-    }
+    });
 
+    report.stages.push_back(timer.stop("estimate_planes", tangent_planes.planes.size()));
     HOPPE_LOG("Tangent plane generation complete. Size: %lu", tangent_planes.planes.size());
     return true;
 }
 
 auto Hoppe::fix_orientations() -> void { 
     HOPPE_LOG("Fixing orientations...");
+    const StageTimer graph_timer;
     
     // Construct a graph using each tangent plane's k-neighborhood,
     // And generate its minimal spanning tree.
@@ -135,82 +412,104 @@ auto Hoppe::fix_orientations() -> void {
     UGraph graph(tangent_planes.planes.size());
     
     const auto num_neighbors = parameters.k + 1;
-    PlaneCloudIndex index(3, tangent_planes, nanoflann::KDTreeSingleIndexAdaptorParams(5));
-    index.buildIndex();
-    
-    // Use thread to parallelize operations
-    const auto num_threads = std::min((int) std::thread::hardware_concurrency(),
-                                      (int) tangent_planes.planes.size());
-    const auto planes_per_thread = (int) ceilf(tangent_planes.planes.size() / num_threads);
-    std::vector<std::thread> threads;
-    std::mutex write_mutex;
-    HOPPE_LOG("Parallelize planes per thread: %d-%d", planes_per_thread, num_threads);
     
-    for (auto thread_id = 0; thread_id < num_threads; thread_id++) {
-        
-        const auto begin_tp_index = thread_id * planes_per_thread;
-        const auto end_tp_index = thread_id == num_threads - 1 ?
-                                    tangent_planes.planes.size() :
-                                    (thread_id + 1) * planes_per_thread;
-        
-        threads.push_back(std::thread([&, begin_tp_index, end_tp_index, thread_id] () {
-            
-            write_mutex.lock();
-            HOPPE_LOG("Processing from %d to %lu", begin_tp_index, end_tp_index);
-            write_mutex.unlock();
+    // Use the pool to parallelize operations
+    const auto num_planes = tangent_planes.planes.size();
+    auto &pool = thread_pool();
+    const auto grain = pool.grain(num_planes);
+    const auto num_chunks = ThreadPool::num_chunks(num_planes, grain);
+    std::mutex log_mutex;
+    HOPPE_LOG("Parallelize planes per chunk: %lu-%lu", grain, num_chunks);
+
+    // First pass: k-neighborhood of every plane, one row per plane.
+    // Missing neighbors are marked with num_planes.
+    std::vector<std::size_t> neighborhoods;
+    if (parameters.shared_knn && point_neighborhoods.size() == num_planes * num_neighbors) {
+        // Plane i was fit to the neighborhood of point i, so that
+        // neighborhood stands in for the one of its center. The plane tree
+        // is then only built when marching needs it.
+        HOPPE_LOG("Reusing point neighborhoods as the Riemannian graph");
+        neighborhoods.swap(point_neighborhoods);
+    } else {
+        build_plane_index();
+        const auto &index = *plane_index;
+        neighborhoods.assign(num_planes * num_neighbors, num_planes);
+        pool.parallel_for(num_planes, grain, [&] (std::size_t begin_tp_index, std::size_t end_tp_index) {
+            NeighborBuffer neighbors(num_neighbors);
             for (auto i = begin_tp_index; i < end_tp_index; i++) {
                 const auto &p1 = tangent_planes.planes[i];
-                std::vector<std::size_t> indices(num_neighbors);
-                std::vector<float> out_squared_dist(num_neighbors);
-                const auto nbhd_count = index.knnSearch(&p1.origin.x, num_neighbors, &indices[0], &out_squared_dist[0]);
-
+                const auto nbhd_count = neighbors.knn(index, &p1.origin.x, num_neighbors, &neighborhoods[i * num_neighbors]);
                 if (nbhd_count != num_neighbors) {
-                    write_mutex.lock();
+                    log_mutex.lock();
                     HOPPE_LOG("WARNING! Failed to find enough neighbors for plane %f %f %f",
                               p1.origin.x,
                               p1.origin.y,
                               p1.origin.z);
-                    write_mutex.unlock();
+                    log_mutex.unlock();
                 }
-
-                // For each of its neighbors...
-                for (auto j = 0; j < nbhd_count; j++) {
-                    const auto p2_plane_index = indices[j];
-                    if (i == p2_plane_index) {
+            }
+        });
+    }
+    report.stages.push_back(graph_timer.stop("orientation_graph", num_planes));
+
+    // Second pass: every chunk collects its own edges. Each undirected edge is
+    // emitted exactly once - by its smaller end, or by its larger end if the
+    // smaller end does not see it - so no locking or deduplication is needed.
+    const StageTimer edges_timer;
+    std::vector<std::vector<Edge> > chunk_edges(num_chunks);
+    pool.parallel_for(num_planes, grain, [&] (std::size_t begin_tp_index, std::size_t end_tp_index) {
+        auto &edges = chunk_edges[begin_tp_index / grain];
+        edges.reserve((end_tp_index - begin_tp_index) * parameters.k);
+        for (auto i = begin_tp_index; i < end_tp_index; i++) {
+            const auto &p1 = tangent_planes.planes[i];
+            const auto row = neighborhoods.begin() + i * num_neighbors;
+
+            // For each of its neighbors...
+            for (auto j = 0; j < num_neighbors; j++) {
+                const auto p2_plane_index = row[j];
+                if (i == p2_plane_index || p2_plane_index == num_planes) {
+                    continue;
+                }
+                if (p2_plane_index < i) {
+                    const auto other_row = neighborhoods.begin() + p2_plane_index * num_neighbors;
+                    if (std::find(other_row, other_row + num_neighbors, i) != other_row + num_neighbors) {
                         continue;
                     }
-                    const auto p2 = tangent_planes.planes[p2_plane_index];
-                    auto cost = 1.0f - fabs(p1.normal.dot(p2.normal));
-                    write_mutex.lock();
-                    graph.add_edge({ IndexToTangentPlane(i),
-                                     p2_plane_index,
-                                     cost });
-                    write_mutex.unlock();
                 }
+                const auto &p2 = tangent_planes.planes[p2_plane_index];
+                const auto cost = 1.0f - fabs(p1.normal.dot(p2.normal));
+                edges.push_back({ std::min(IndexToTangentPlane(i), p2_plane_index),
+                                  std::max(IndexToTangentPlane(i), p2_plane_index),
+                                  (float) cost });
             }
-            write_mutex.lock();
-            HOPPE_LOG("Thread %d completed.", thread_id);
-            write_mutex.unlock();
+        }
+    });
 
-        }));
+    auto num_edges = 0ul;
+    for (const auto &edges : chunk_edges) {
+        num_edges += edges.size();
     }
-
-    for (auto &thread : threads) {
-        thread.join();
+    graph.edges.reserve(num_edges);
+    for (auto &edges : chunk_edges) {
+        graph.edges.insert(graph.edges.end(), edges.begin(), edges.end());
+        std::vector<Edge>().swap(edges);
     }
+    std::vector<std::size_t>().swap(neighborhoods);
+    report.stages.push_back(edges_timer.stop("orientation_edges", graph.edges.size()));
 
-    graph.clean_duplicate_edges();
-    
     HOPPE_LOG("Graph generation done. #nodes: %lu, #edges: %lu",
               graph.num_nodes,
               graph.edges.size());
     
-    const auto mst = graph.generate_mst();
+    const StageTimer mst_timer;
+    const auto mst = graph.generate_mst(parameters.mst_algorithm, &pool);
+    report.stages.push_back(mst_timer.stop("orientation_mst", mst.edges.size()));
 
     HOPPE_LOG("Minimal spanning tree generation done. #nodes: %lu, #edges: %lu",
               mst.num_nodes,
               mst.edges.size());
     
+    const StageTimer traversal_timer;
     auto highest = std::max_element(tangent_planes.planes.begin(),
                      tangent_planes.planes.end(),
                      [] (const auto &p1, const auto &p2) {
@@ -221,41 +520,61 @@ auto Hoppe::fix_orientations() -> void {
         highest->normal = -highest->normal;
     }
     auto corrected = 0;
-    auto previous = *highest;
-    mst.traverse_dfs((int) (highest - tangent_planes.planes.begin()), [&] (const auto idx) {
-        if (tangent_planes.planes[idx].normal.dot(previous.normal) < 0.0f) {
+    mst.traverse_dfs((int) (highest - tangent_planes.planes.begin()), [&] (const auto idx, const auto parent) {
+        if (parent < 0) {
+            return;
+        }
+        // Propagate orientation along the tree edge we came from
+        if (tangent_planes.planes[idx].normal.dot(tangent_planes.planes[parent].normal) < 0.0f) {
             tangent_planes.planes[idx].normal = -tangent_planes.planes[idx].normal;
             corrected++;
         }
-        previous = tangent_planes.planes[idx];
     });
     
+    report.stages.push_back(traversal_timer.stop("orientation_traversal", corrected));
     HOPPE_LOG("Normal correction done. Corrected: #%d", corrected);
 }
 
-auto Hoppe::sdf(cv::Point3f point) -> std::optional<float> {
-    auto closest_index = -1;
-    auto closest_dist = 0.0f;
-
-    for (auto i = 0; i < tangent_planes.planes.size(); i++) {
-        const auto &plane = tangent_planes.planes[i];
-        const auto dist_to_sample_point = cv::norm(point - plane.origin);
-        if (closest_index == -1 || dist_to_sample_point < closest_dist) {
-            closest_dist = dist_to_sample_point;
-            closest_index = i;
-        }
+auto Hoppe::thread_pool() -> ThreadPool & {
+    const auto num_threads = parameters.num_threads > 0 ?
+        parameters.num_threads :
+        std::max(1u, std::thread::hardware_concurrency());
+    if (!pool || pool->size() != num_threads) {
+        pool.reset();
+        pool = std::make_unique<ThreadPool>(num_threads);
+        marcher.use_pool(pool.get());
     }
-    if (closest_index == -1) {
+    return *pool;
+}
+
+auto Hoppe::build_point_index() -> void {
+    point_index = std::make_unique<PointCloudIndex>(3, pointcloud, nanoflann::KDTreeSingleIndexAdaptorParams(10));
+    point_index->buildIndex();
+}
+
+auto Hoppe::build_plane_index() -> void {
+    plane_index = std::make_unique<PlaneCloudIndex>(3, tangent_planes, nanoflann::KDTreeSingleIndexAdaptorParams(5));
+    plane_index->buildIndex();
+}
+
+auto Hoppe::sdf(cv::Point3f point) const -> std::optional<float> {
+    if (!plane_index || tangent_planes.planes.size() == 0) {
         HOPPE_LOG("Could not calculate SDF as there is no plane.");
         return {};
     }
+    std::size_t closest_index;
+    float closest_squared_dist;
+    const auto found = plane_index->knnSearch(&point.x, 1, &closest_index, &closest_squared_dist);
+    if (found == 0) {
+        return {};
+    }
     const auto &plane = tangent_planes.planes[closest_index];
     const auto normal_p = VEC2POINT(plane.normal);
 
     // Calculate projected length on normal.
     const auto projected_length = (point - plane.origin).dot(normal_p);
     const auto z = plane.origin - projected_length * normal_p;
-    if (cv::norm(z - plane.origin) >= parameters.density + parameters.noise) {
+    if (cv::norm(z - plane.origin) >= grid_resolution + parameters.noise) {
         return {};
     }
     return projected_length;
@@ -322,58 +641,202 @@ auto Hoppe::export_to_ply(const std::string path) -> void {
 }
 
 auto Hoppe::cube_march() -> void {
+    const StageTimer bounds_timer;
     cv::Vec3f bounding_box_min, bounding_box_max;
     calculate_bounds(bounding_box_min, bounding_box_max);
     auto size = bounding_box_max - bounding_box_min;
     HOPPE_LOG("Bounding box size: %f %f %f", size(0), size(1), size(2));
 
-    parameters.density = density_estimation(size);
+    // Coarsened below to fit the budget; `parameters` stay as the caller set them
+    auto density = density_estimation(size);
 
     // OVERRIDE
 //    bounding_box_min = cv::Vec3f(-1.0f, -1.0f, -1.0f);
 //    bounding_box_max = cv::Vec3f(1.0f, 1.0f, 1.0f);
 //    size = bounding_box_max - bounding_box_min;
-//    parameters.density = 0.01f;
-
-    cv::Vec3i marching_size(ceilf(size(0) / parameters.density),
-                            ceilf(size(1) / parameters.density),
-                            ceilf(size(2) / parameters.density));
-    auto volume = 0;
-    do {
-        volume = marching_size(0) * marching_size(1) * marching_size(2);
-        if (volume > parameters.max_volume) {
-            parameters.density *= 2.0f;
-            marching_size = cv::Vec3i(ceilf(size(0) / parameters.density),
-                                      ceilf(size(1) / parameters.density),
-                                      ceilf(size(2) / parameters.density));
+//    density = 0.01f;
+
+    const auto grid_size = [&] () {
+        return cv::Vec3i(ceilf(size(0) / density),
+                         ceilf(size(1) / density),
+                         ceilf(size(2) / density));
+    };
+    // sdf() answers a vertex whose projection onto the nearest tangent plane
+    // lies within density + noise of the plane origin, however far it is
+    // along the normal. Across a cell the distance to one plane changes by
+    // at most a cell diagonal, so only vertices within sqrt(3) * density of
+    // the plane can sit on a cell whose sign that plane changes. Those lie
+    // within sqrt((density + noise)^2 + 3 * density^2) of the origin, which
+    // the sum below bounds. The vertices left out are further along the
+    // normal and count as misses, like every other vertex off the band.
+    const auto band_radius = [&] () {
+        return density + parameters.noise + sqrtf(3.0f) * density;
+    };
+    std::vector<cv::Point3f> centers;
+    if (parameters.narrow_band) {
+        centers.resize(tangent_planes.planes.size());
+        for (auto i = 0; i < centers.size(); i++) {
+            centers[i] = tangent_planes.planes[i].origin;
+        }
+    }
+    if (!plane_index) {
+        build_plane_index();
+    }
+
+    // Coarsening stops at a single vertex, or a single brick for sparse
+    // grids, so no density meets a budget below that.
+    const auto sparse = parameters.grid_mode == GridMode::sparse && parameters.narrow_band;
+    const auto min_volume = sparse ? (unsigned long) BrickGrid<float>::volume : 1ul;
+    auto max_volume = parameters.max_volume;
+    if (max_volume < min_volume) {
+        HOPPE_LOG("WARNING! Grid budget of %lu vertices is below the minimum of %lu, using the minimum.",
+                  max_volume, min_volume);
+        max_volume = min_volume;
+    }
+
+    auto marching_size = grid_size();
+    if (sparse) {
+        // Bricks only cover the band, so the budget applies to the vertices
+        // actually stored instead of the bounding box volume. Densities whose
+        // center bricks alone go over it are skipped without splatting the
+        // band, which usually leaves one or two tries for `set_band`.
+        const auto max_axis = (1 << 21) * BrickGrid<float>::width;
+        while (true) {
+            if (marching_size(0) < max_axis && marching_size(1) < max_axis && marching_size(2) < max_axis &&
+                CubeMarcher::count_center_bricks(centers, density, VEC2POINT(bounding_box_min)) *
+                BrickGrid<float>::volume <= max_volume) {
+                marcher.init(marching_size, density, GridMode::sparse);
+                if (marcher.set_band(centers, band_radius(), VEC2POINT(bounding_box_min), max_volume)) {
+                    break;
+                }
+            }
+            density *= 2.0f;
+            marching_size = grid_size();
+        }
+    } else {
+        auto mode = parameters.grid_mode;
+        if (mode == GridMode::sparse) {
+            HOPPE_LOG("WARNING! The sparse grid needs the narrow band, marching a dense grid.");
+            mode = GridMode::dense;
+        }
+        // Streaming keeps two planes in memory, but still visits the whole
+        // volume, so the budget bounds its running time.
+        auto volume = 0;
+        do {
+            volume = marching_size(0) * marching_size(1) * marching_size(2);
+            if (volume > max_volume) {
+                density *= 2.0f;
+                marching_size = grid_size();
+            }
+        } while (volume > max_volume);
+        marcher.init(marching_size, density, mode);
+        if (parameters.narrow_band) {
+            marcher.set_band(centers, band_radius(), VEC2POINT(bounding_box_min));
         }
-    } while (volume > parameters.max_volume);
+    }
+    grid_resolution = density;
     
     HOPPE_LOG("Marching cube size: %d %d %d", marching_size(0),
               marching_size(1), marching_size(2));
-    marcher.init(marching_size, parameters.density);
     HOPPE_LOG("Estimated: from %f %f %f to %f %f %f",
               bounding_box_min(0), bounding_box_min(1), bounding_box_min(2),
               bounding_box_max(0), bounding_box_max(1), bounding_box_max(2));
-
+    report.stages.push_back(bounds_timer.stop("bounds", marcher.stored_vertices()));
+
+    // Only streaming grids hand the mesh over while marching; the others
+    // finish it in memory and write it in one go afterwards.
+    std::unique_ptr<MeshWriter> writer;
+    mesh_streamed = !mesh_output.empty() && parameters.grid_mode == GridMode::streaming;
+    if (mesh_streamed) {
+        HOPPE_LOG("Streaming mesh to %s...", mesh_output.c_str());
+        writer = std::make_unique<MeshWriter>(mesh_output, MeshWriter::format_for(mesh_output));
+    }
+    const auto march_begin = std::chrono::steady_clock::now();
     marcher.march([&] (cv::Point3f p) {
         return sdf(p);
-    }, VEC2POINT(bounding_box_min));
+    }, VEC2POINT(bounding_box_min), writer ? writer->sink() : MeshSink());
+    const std::chrono::duration<double, std::micro> march_time = std::chrono::steady_clock::now() - march_begin;
+    report.stages.insert(report.stages.end(), marcher.stages.begin(), marcher.stages.end());
+    if (writer) {
+        // The writer ran alongside the marcher; this is what it still had to do
+        const StageTimer export_timer;
+        writer->finish();
+        const auto triangulation = report.find("triangulation");
+        report.stages.push_back(export_timer.stop("export", triangulation ? triangulation->items : 0));
+    } else if (!mesh_output.empty()) {
+        const StageTimer export_timer;
+        MeshWriter::write(mesh_output, MeshWriter::format_for(mesh_output), marcher.vertices, marcher.indices);
+        report.stages.push_back(export_timer.stop("export", marcher.indices.size() / 3));
+    }
+    const auto sdf_stage = report.find("sdf");
+    const auto num_queries = sdf_stage ? sdf_stage->items : 0;
+    HOPPE_LOG("SDF queries: %lu against %lu planes, %f us per query (marching included)",
+              num_queries,
+              tangent_planes.planes.size(),
+              num_queries > 0 ? march_time.count() / num_queries : 0.0);
 }
 
-auto Hoppe::export_mesh(const std::string path) -> void {
-    HOPPE_LOG("Exporting mesh to %s as .obj format...", path.c_str());
-    std::ofstream obj_file(path);
+auto Hoppe::stream_mesh(const std::string path) -> void {
+    mesh_output = path;
+}
+
+auto Hoppe::export_mesh(const std::string path) -> bool {
+    if (mesh_streamed) {
+        HOPPE_LOG("ERR! The mesh was streamed to %s and is not in memory, not exporting it to %s",
+                  mesh_output.c_str(), path.c_str());
+        return false;
+    }
+    HOPPE_LOG("Exporting mesh to %s...", path.c_str());
+    const StageTimer export_timer;
+    const auto written = MeshWriter::write(path, MeshWriter::format_for(path), marcher.vertices, marcher.indices);
+    report.stages.push_back(export_timer.stop("export", marcher.indices.size() / 3));
+    if (!report_output.empty()) {
+        report.write_json(report_output);
+    }
+    return written;
+}
 
-    for (auto i = 0; i < marcher.faces.size(); i++) {
-        const auto &pts = marcher.faces[i].points;
-        obj_file << "v " << pts[0].x << " " << pts[0].y << " " << pts[0].z << std::endl;
-        obj_file << "v " << pts[1].x << " " << pts[1].y << " " << pts[1].z << std::endl;
-        obj_file << "v " << pts[2].x << " " << pts[2].y << " " << pts[2].z << std::endl;
+auto Hoppe::save_cache(const std::string path) -> bool {
+    if (!point_index) {
+        build_point_index();
     }
-    for (auto i = 0; i < marcher.faces.size(); i++) {
-        const auto base_idx = i * 3 + 1;
-        obj_file << "f " << base_idx << " " << (base_idx + 1) << " " << (base_idx + 2) << std::endl;
+    // Planes that were never oriented are not worth keeping
+    const Planes no_planes;
+    const auto &planes = plane_settings.k != 0 ? tangent_planes : no_planes;
+    if (plane_settings.k != 0 && !plane_index) {
+        build_plane_index();
     }
-    obj_file.close();
+    return PointCloudCache::write(path,
+                                  pointcloud,
+                                  planes,
+                                  plane_settings,
+                                  source,
+                                  point_index.get(),
+                                  plane_settings.k != 0 ? plane_index.get() : nullptr);
+}
+
+auto Hoppe::load_cache(const std::string path, const std::string source) -> bool {
+    const StageTimer load_timer;
+    load_stage = StageReport();
+    // The cache keeps points in the order they were saved in
+    original_order.clear();
+    if (!PointCloudCache::read(path, pointcloud, tangent_planes, plane_settings, this->source, point_index, plane_index)) {
+        return false;
+    }
+    if (!source.empty() && !(this->source == CacheSource::of(source))) {
+        HOPPE_LOG("WARNING! %s was not built from %s as it is now, ignoring it", path.c_str(), source.c_str());
+        pointcloud.points.clear();
+        tangent_planes.planes.clear();
+        point_index.reset();
+        plane_index.reset();
+        plane_settings = PlaneSettings();
+        this->source = CacheSource();
+        return false;
+    }
+    load_stage = load_timer.stop("load", pointcloud.points.size());
+    return true;
+}
+
+auto Hoppe::write_report(const std::string path) -> void {
+    report_output = path;
 }
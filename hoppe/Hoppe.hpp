@@ -10,10 +10,14 @@
 
 
 #include <optional>
+#include <memory>
 #include <opencv2/calib3d.hpp>
 #include <opencv2/core.hpp>
 #include "hoppe_common.hpp"
 #include "CubeMarcher.hpp"
+#include "Instrumentation.hpp"
+#include "ThreadPool.hpp"
+#include "PointCloudCache.hpp"
 
 #define IN
 #define OUT
@@ -21,26 +25,114 @@
 
 class Hoppe {
 public:
-    Hoppe() : parameters({ 8, -1.0f, 0.0f, 0.0f, 8000000ul }) {}
+    Hoppe() : parameters({ 8, -1.0f, 0.0f, 0.0f, 8000000ul, MSTAlgorithm::kruskal, true, GridMode::dense, 0, false, true }) {}
 
     Hoppe(Parameters param) : parameters(param) {}
 
     ~Hoppe() = default;
     
     /// Runs the Hoppe Surface Reconstruction method.
-    /// @returns true on success
-    auto run() -> bool;
+    /// @returns time, memory and item count of every stage, and whether it succeeded
+    auto run() -> RunReport;
 
 
     /// Loads point cloud from `path`.
     /// @param path path to load point cloud
     auto load_pointcloud(std::string path) -> void;
+
+    /// Takes a point cloud that is already in memory.
+    /// @param points points to reconstruct
+    auto set_pointcloud(std::vector<cv::Point3f> points) -> void;
+    
+    /// Writes the mesh the last `run` kept in memory to `path` (.obj, binary
+    /// .ply or binary .stl) and adds the time it took to `last_report`.
+    /// @param path file to write
+    /// @returns false if the mesh could not be written, or was streamed
+    ///     instead of kept in memory
+    auto export_mesh(const std::string path) -> bool;
+
+    /// Report of the last `run`, with the stages of later `export_mesh` calls.
+    auto last_report() const -> const RunReport & {
+        return report;
+    }
+
+    /// Vertices of the mesh the last `run` kept in memory.
+    auto mesh_vertices() const -> const std::vector<cv::Point3f> & {
+        return marcher.vertices;
+    }
+
+    /// Three vertex indices per triangle of the mesh the last `run` kept in memory.
+    auto mesh_indices() const -> const std::vector<std::uint32_t> & {
+        return marcher.indices;
+    }
+
+    /// Points loaded or set last, in the order `run` keeps them.
+    auto points() const -> const std::vector<cv::Point3f> & {
+        return pointcloud.points;
+    }
+
+    /// Position in the loaded cloud of every point of `points` and `planes`.
+    /// Empty while the points are still in load order.
+    auto original_indices() const -> const std::vector<std::size_t> & {
+        return original_order;
+    }
+
+    /// Oriented tangent planes of the last `run`, one per point.
+    auto planes() const -> const std::vector<Plane> & {
+        return tangent_planes.planes;
+    }
+
+    /// Signed distance from `point` to the surface of the last `run`, as the
+    /// marcher samples it.
+    /// @param point point to calculate distance from
+    /// @returns the distance, empty away from every tangent plane
+    auto signed_distance(cv::Point3f point) const -> std::optional<float> {
+        return sdf(point);
+    }
+
+    /// Distance between grid vertices in the last `run`, which is also how
+    /// far along a tangent plane `signed_distance` reaches.
+    auto resolution() const -> float {
+        return grid_resolution;
+    }
+
+    /// Writes the mesh of every later `run` to `path` (.obj, binary .ply or
+    /// binary .stl). Streaming grids write it while marching and do not keep
+    /// it for `export_mesh`; the others write it once marching is done.
+    /// @param path file to write, empty to keep the mesh in memory only
+    auto stream_mesh(const std::string path) -> void;
     
-    auto export_mesh(const std::string path) -> void;
+    /// Writes the report of every later `run` to `path` as JSON, and again
+    /// with the export stage after every `export_mesh`.
+    /// @param path file to write, empty to only return the report
+    auto write_report(const std::string path) -> void;
+
+    /// Saves the point cloud, the oriented tangent planes of the last run
+    /// and both kd-trees, so later runs can skip straight to marching.
+    /// @param path file to write
+    /// @returns true on success
+    auto save_cache(const std::string path) -> bool;
+
+    /// Loads a cache written by `save_cache` instead of a point cloud.
+    /// `run` then reuses its planes while the parameters they depend on
+    /// (see `PlaneSettings`) stay the same.
+    /// @param path file to read
+    /// @param source point cloud the cache must have been built from, as it
+    ///     is now; empty to take the cache as it is
+    /// @returns false if the cache is missing, corrupt or stale
+    auto load_cache(const std::string path, const std::string source = "") -> bool;
     
     Parameters parameters;
     
 private:
+    /// Sorts the point cloud along a Morton curve and records where every
+    /// point came from in `original_order`.
+    auto sort_spatially() -> void;
+
+    /// Pool with `parameters.num_threads` threads, shared by every stage
+    /// and the marcher. Started on first use, restarted if the count changed.
+    auto thread_pool() -> ThreadPool &;
+
     auto estimate_planes() -> bool;
     
     auto fix_orientations() -> void;
@@ -62,11 +154,20 @@ private:
                           OUT cv::Vec3f &bounding_box_max) -> void;
 
 
+    /// Builds the nearest neighbor tree over the point cloud.
+    auto build_point_index() -> void;
+
+
+    /// Builds the nearest neighbor tree over tangent plane origins.
+    /// The tree is kept alive so it can serve all later SDF queries.
+    auto build_plane_index() -> void;
+
+
     /// Find the signed distance from the sample point to the model M.
     /// In reality, M is not really known, however we do have tangent planes.
     /// So we sample tangent plane instead.
     /// @param point point to calculate distance from
-    auto sdf(cv::Point3f point) -> std::optional<float>;
+    auto sdf(cv::Point3f point) const -> std::optional<float>;
     
 
     /// For debugging purposes only. Exports planecloud to path.
@@ -74,8 +175,28 @@ private:
     auto export_to_ply(const std::string path) -> void;
     
     PointCloud pointcloud;
+    std::vector<std::size_t> original_order;
+    std::unique_ptr<PointCloudIndex> point_index;
     Planes tangent_planes;
+    // k + 1 nearest points of every point, kept from estimate_planes for
+    // fix_orientations when `parameters.shared_knn` is set
+    std::vector<std::size_t> point_neighborhoods;
+    // Settings the tangent planes were estimated and oriented with; k is 0 if they were not
+    PlaneSettings plane_settings;
+    // File the points came from, recorded in caches
+    CacheSource source;
+    std::unique_ptr<PlaneCloudIndex> plane_index;
     CubeMarcher marcher;
+    // Vertex spacing the last run marched with, after fitting the budget
+    float grid_resolution = 0.0f;
+    std::string mesh_output;
+    // Whether the last run handed its mesh to a writer instead of keeping it
+    bool mesh_streamed = false;
+    // Kept from the last load, so every run reports where its input came from
+    StageReport load_stage;
+    RunReport report;
+    std::string report_output;
+    std::unique_ptr<ThreadPool> pool;
 };
 
 #endif /* Hoppe_hpp */
@@ -0,0 +1,98 @@
+//
+//  Instrumentation.cpp
+//  hoppe
+//
+//  Created by apple on 16/10/2026.
+//
+
+#include "Instrumentation.hpp"
+#include <cstdio>
+#include <algorithm>
+#include <sys/resource.h>
+#include "hoppe_common.hpp"
+
+auto process_cpu_seconds() -> double {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0.0;
+    }
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec * 1e-6 +
+        usage.ru_stime.tv_sec + usage.ru_stime.tv_usec * 1e-6;
+}
+
+auto process_peak_rss() -> std::size_t {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return (std::size_t) usage.ru_maxrss;
+#else
+    // Linux reports kilobytes
+    return (std::size_t) usage.ru_maxrss * 1024;
+#endif
+}
+
+StageTimer::StageTimer() : wall_begin(std::chrono::steady_clock::now()), cpu_begin(process_cpu_seconds()) {}
+
+auto StageTimer::stop(const std::string &name, std::size_t items) const -> StageReport {
+    StageReport stage;
+    stage.name = name;
+    stop(stage, items);
+    return stage;
+}
+
+auto StageTimer::stop(StageReport &stage, std::size_t items) const -> void {
+    const std::chrono::duration<double> wall_time = std::chrono::steady_clock::now() - wall_begin;
+    stage.wall_seconds += wall_time.count();
+    stage.cpu_seconds += process_cpu_seconds() - cpu_begin;
+    stage.peak_rss = std::max(stage.peak_rss, process_peak_rss());
+    stage.items += items;
+}
+
+auto RunReport::find(const std::string &name) const -> const StageReport * {
+    const auto it = std::find_if(stages.begin(), stages.end(), [&] (const auto &stage) {
+        return stage.name == name;
+    });
+    return it == stages.end() ? nullptr : &*it;
+}
+
+auto RunReport::log() const -> void {
+    for (const auto &stage : stages) {
+        HOPPE_LOG("%-22s wall %9.3f ms, cpu %9.3f ms, peak RSS %8.2f MB, items %lu",
+                  stage.name.c_str(),
+                  stage.wall_seconds * 1000.0,
+                  stage.cpu_seconds * 1000.0,
+                  stage.peak_rss / 1048576.0,
+                  stage.items);
+    }
+}
+
+auto RunReport::write_json(const std::string &path) const -> bool {
+    auto file = std::fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        HOPPE_LOG("WARNING! Bad writer: %s", path.c_str());
+        return false;
+    }
+    std::fprintf(file, "{\n  \"success\": %s,\n  \"stages\": [", success ? "true" : "false");
+    for (auto i = 0ul; i < stages.size(); i++) {
+        const auto &stage = stages[i];
+        // Stage names are plain identifiers, so they need no escaping
+        std::fprintf(file,
+                     "%s\n    { \"name\": \"%s\", \"wall_seconds\": %.9f, \"cpu_seconds\": %.9f, "
+                     "\"peak_rss_bytes\": %lu, \"items\": %lu }",
+                     i == 0 ? "" : ",",
+                     stage.name.c_str(),
+                     stage.wall_seconds,
+                     stage.cpu_seconds,
+                     stage.peak_rss,
+                     stage.items);
+    }
+    std::fprintf(file, "\n  ]\n}\n");
+    const auto failed = std::ferror(file) != 0;
+    if (std::fclose(file) != 0 || failed) {
+        HOPPE_LOG("WARNING! Failed writing %s", path.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,70 @@
+//
+//  Instrumentation.hpp
+//  hoppe
+//
+//  Created by apple on 16/10/2026.
+//
+
+#ifndef Instrumentation_hpp
+#define Instrumentation_hpp
+
+#include <string>
+#include <vector>
+#include <chrono>
+
+/// Resources one pipeline stage used.
+struct StageReport {
+    std::string name;
+    double wall_seconds = 0.0;
+    // User and system time of the whole process, so every thread counts
+    double cpu_seconds = 0.0;
+    // High-water mark of the process when the stage ended, in bytes
+    std::size_t peak_rss = 0;
+    // What the stage worked on: points, planes, edges, SDF queries...
+    std::size_t items = 0;
+};
+
+/// Measures a stage from its construction on.
+class StageTimer {
+public:
+    StageTimer();
+
+    /// @param name stage name
+    /// @param items number of items the stage processed
+    /// @returns the resources used since construction
+    auto stop(const std::string &name, std::size_t items) const -> StageReport;
+
+    /// Adds the resources used since construction to a stage that runs in pieces.
+    /// @param stage stage to add to
+    /// @param items number of items this piece processed
+    auto stop(StageReport &stage, std::size_t items) const -> void;
+
+private:
+    std::chrono::steady_clock::time_point wall_begin;
+    double cpu_begin;
+};
+
+/// Stages of one `Hoppe::run`, in the order they ran.
+struct RunReport {
+    bool success = false;
+    std::vector<StageReport> stages;
+
+    /// @returns the stage called `name`, or null if it did not run
+    auto find(const std::string &name) const -> const StageReport *;
+
+    /// Logs one line per stage.
+    auto log() const -> void;
+
+    /// Writes the report as JSON.
+    /// @param path file to write
+    /// @returns true on success
+    auto write_json(const std::string &path) const -> bool;
+};
+
+/// User and system time the process used so far, in seconds.
+auto process_cpu_seconds() -> double;
+
+/// Largest resident set size the process had so far, in bytes.
+auto process_peak_rss() -> std::size_t;
+
+#endif /* Instrumentation_hpp */
@@ -0,0 +1,309 @@
+//
+//  MarchingCubesTables.hpp
+//  hoppe
+//
+//  Created by apple on 16/10/2026.
+//
+
+#ifndef MarchingCubesTables_hpp
+#define MarchingCubesTables_hpp
+
+#include <cstdint>
+
+
+/// Offsets of the 8 cell corners, in grid steps. Corner i contributes bit i to the cell state.
+constexpr int corner_offsets[8][3] = {
+    { 0, 0, 0 },
+    { 1, 0, 0 },
+    { 1, 1, 0 },
+    { 0, 1, 0 },
+    { 0, 0, 1 },
+    { 1, 0, 1 },
+    { 1, 1, 1 },
+    { 0, 1, 1 }
+};
+
+/// The two corners joined by each of the 12 cell edges.
+constexpr int edge_corners[12][2] = {
+    { 0, 1 },
+    { 1, 2 },
+    { 3, 2 },
+    { 0, 3 },
+    { 4, 5 },
+    { 5, 6 },
+    { 7, 6 },
+    { 4, 7 },
+    { 0, 4 },
+    { 1, 5 },
+    { 2, 6 },
+    { 3, 7 }
+};
+
+/// Triangles for every cell state, as triples of edge indices terminated by -1.
+/// A state has at most 5 triangles. Triangles only use edges whose corners
+/// differ in sign and face the positive corners; faces with two positive and
+/// two negative corners on a diagonal always cut the positive corners off,
+/// so neighbouring cells agree and the surface is closed. Diagonals added to
+/// split a polygon never lie inside a cell face, where the neighbouring cell
+/// would cut the same face again and leave an edge with four triangles.
+/// `hoppe_bench check` verifies all of this.
+constexpr std::int8_t triangle_table[256][16] = {
+    { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 0
+    {  3,  0,  8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 1
+    {  1,  9,  0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 2
+    {  3,  9,  8,  3,  1,  9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 3
+    { 10,  1,  2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 4
+    { 10,  1,  2,  0,  8,  3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 5
+    { 10,  0,  2, 10,  9,  0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 6
+    {  2,  8,  3,  2, 10,  8, 10,  9,  8, -1, -1, -1, -1, -1, -1, -1 },  // 7
+    { 11,  2,  3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 8
+    {  2,  8, 11,  2,  0,  8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 9
+    { 11,  2,  3,  1,  9,  0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 10
+    {  1, 11,  2,  1,  9, 11,  9,  8, 11, -1, -1, -1, -1, -1, -1, -1 },  // 11
+    { 11,  1,  3, 11, 10,  1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 12
+    {  0, 10,  1,  0,  8, 10,  8, 11, 10, -1, -1, -1, -1, -1, -1, -1 },  // 13
+    {  3,  9,  0,  3, 11,  9, 11, 10,  9, -1, -1, -1, -1, -1, -1, -1 },  // 14
+    {  9,  8, 10, 10,  8, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 15
+    {  8,  4,  7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 16
+    {  0,  7,  3,  0,  4,  7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 17
+    {  1,  9,  0,  4,  7,  8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 18
+    {  4,  1,  9,  4,  7,  1,  7,  3,  1, -1, -1, -1, -1, -1, -1, -1 },  // 19
+    {  8,  4,  7, 10,  1,  2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 20
+    {  7,  0,  4,  7,  3,  0,  2, 10,  1, -1, -1, -1, -1, -1, -1, -1 },  // 21
+    { 10,  0,  2, 10,  9,  0,  4,  7,  8, -1, -1, -1, -1, -1, -1, -1 },  // 22
+    {  9,  4, 10, 10,  4,  7, 10,  7,  2,  2,  7,  3, -1, -1, -1, -1 },  // 23
+    {  4,  7,  8, 11,  2,  3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 24
+    { 11,  4,  7, 11,  2,  4,  2,  0,  4, -1, -1, -1, -1, -1, -1, -1 },  // 25
+    {  0,  1,  9,  2,  3, 11,  4,  7,  8, -1, -1, -1, -1, -1, -1, -1 },  // 26
+    {  2,  1, 11, 11,  1,  9, 11,  9,  7,  7,  9,  4, -1, -1, -1, -1 },  // 27
+    {  1, 11, 10,  1,  3, 11,  8,  4,  7, -1, -1, -1, -1, -1, -1, -1 },  // 28
+    { 10,  7, 11, 10,  4,  7, 10,  1,  4,  1,  0,  4, -1, -1, -1, -1 },  // 29
+    {  0,  3, 11,  0, 11, 10,  0, 10,  9,  7,  8,  4, -1, -1, -1, -1 },  // 30
+    { 11, 10,  9, 11,  9,  4,  7, 11,  4, -1, -1, -1, -1, -1, -1, -1 },  // 31
+    {  9,  5,  4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 32
+    {  3,  0,  8,  9,  5,  4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 33
+    {  1,  4,  0,  1,  5,  4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 34
+    {  8,  5,  4,  8,  3,  5,  3,  1,  5, -1, -1, -1, -1, -1, -1, -1 },  // 35
+    {  4,  9,  5,  1,  2, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 36
+    {  8,  3,  0,  1,  2, 10,  9,  5,  4, -1, -1, -1, -1, -1, -1, -1 },  // 37
+    {  5,  2, 10,  5,  4,  2,  4,  0,  2, -1, -1, -1, -1, -1, -1, -1 },  // 38
+    {  4,  8,  5,  5,  8,  3,  5,  3, 10, 10,  3,  2, -1, -1, -1, -1 },  // 39
+    { 11,  2,  3,  9,  5,  4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 40
+    {  2,  8, 11,  2,  0,  8,  9,  5,  4, -1, -1, -1, -1, -1, -1, -1 },  // 41
+    {  4,  1,  5,  4,  0,  1,  3, 11,  2, -1, -1, -1, -1, -1, -1, -1 },  // 42
+    {  5,  2,  1,  5, 11,  2,  5,  4, 11,  4,  8, 11, -1, -1, -1, -1 },  // 43
+    { 11,  1,  3, 11, 10,  1,  5,  4,  9, -1, -1, -1, -1, -1, -1, -1 },  // 44
+    {  8, 11, 10,  8, 10,  1,  8,  1,  0,  9,  5,  4, -1, -1, -1, -1 },  // 45
+    {  0,  3,  4,  4,  3, 11,  4, 11,  5,  5, 11, 10, -1, -1, -1, -1 },  // 46
+    {  8, 11, 10,  8, 10,  5,  4,  8,  5, -1, -1, -1, -1, -1, -1, -1 },  // 47
+    {  8,  5,  7,  8,  9,  5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 48
+    {  9,  3,  0,  9,  5,  3,  5,  7,  3, -1, -1, -1, -1, -1, -1, -1 },  // 49
+    {  0,  7,  8,  0,  1,  7,  1,  5,  7, -1, -1, -1, -1, -1, -1, -1 },  // 50
+    {  5,  7,  1,  1,  7,  3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 51
+    {  8,  5,  7,  8,  9,  5,  1,  2, 10, -1, -1, -1, -1, -1, -1, -1 },  // 52
+    {  9,  5,  7,  9,  7,  3,  9,  3,  0,  1,  2, 10, -1, -1, -1, -1 },  // 53
+    {  7, 10,  5,  7,  2, 10,  7,  8,  2,  8,  0,  2, -1, -1, -1, -1 },  // 54
+    {  5,  7,  3,  5,  3,  2, 10,  5,  2, -1, -1, -1, -1, -1, -1, -1 },  // 55
+    {  5,  8,  9,  5,  7,  8, 11,  2,  3, -1, -1, -1, -1, -1, -1, -1 },  // 56
+    {  0,  9,  2,  2,  9,  5,  2,  5, 11, 11,  5,  7, -1, -1, -1, -1 },  // 57
+    {  0,  1,  5,  0,  5,  7,  0,  7,  8,  2,  3, 11, -1, -1, -1, -1 },  // 58
+    {  1,  5,  7,  1,  7, 11,  2,  1, 11, -1, -1, -1, -1, -1, -1, -1 },  // 59
+    {  8,  5,  7,  8,  9,  5,  3, 11, 10,  3, 10,  1, -1, -1, -1, -1 },  // 60
+    {  0,  9,  5,  5,  7, 11,  0,  5, 11, 11, 10,  1,  0, 11,  1, -1 },  // 61
+    {  0,  3, 11,  0, 11, 10,  0, 10,  5,  0,  5,  7,  0,  7,  8, -1 },  // 62
+    { 10,  5,  7, 11, 10,  7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 63
+    {  5, 10,  6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 64
+    {  3,  0,  8,  5, 10,  6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 65
+    {  0,  1,  9, 10,  6,  5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 66
+    {  3,  9,  8,  3,  1,  9, 10,  6,  5, -1, -1, -1, -1, -1, -1, -1 },  // 67
+    {  5,  2,  6,  5,  1,  2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 68
+    {  5,  2,  6,  5,  1,  2,  0,  8,  3, -1, -1, -1, -1, -1, -1, -1 },  // 69
+    {  9,  6,  5,  9,  0,  6,  0,  2,  6, -1, -1, -1, -1, -1, -1, -1 },  // 70
+    {  8,  5,  9,  8,  6,  5,  8,  3,  6,  3,  2,  6, -1, -1, -1, -1 },  // 71
+    {  5, 10,  6,  2,  3, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 72
+    {  8,  2,  0,  8, 11,  2,  6,  5, 10, -1, -1, -1, -1, -1, -1, -1 },  // 73
+    {  0,  1,  9,  2,  3, 11, 10,  6,  5, -1, -1, -1, -1, -1, -1, -1 },  // 74
+    {  1,  9,  8,  1,  8, 11,  1, 11,  2, 10,  6,  5, -1, -1, -1, -1 },  // 75
+    {  6,  3, 11,  6,  5,  3,  5,  1,  3, -1, -1, -1, -1, -1, -1, -1 },  // 76
+    {  1,  0,  5,  5,  0,  8,  5,  8,  6,  6,  8, 11, -1, -1, -1, -1 },  // 77
+    {  0,  3,  9,  9,  3, 11,  9, 11,  5,  5, 11,  6, -1, -1, -1, -1 },  // 78
+    {  9,  8, 11,  9, 11,  6,  5,  9,  6, -1, -1, -1, -1, -1, -1, -1 },  // 79
+    {  8,  4,  7,  5, 10,  6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 80
+    {  0,  7,  3,  0,  4,  7,  5, 10,  6, -1, -1, -1, -1, -1, -1, -1 },  // 81
+    {  0,  1,  9,  4,  7,  8, 10,  6,  5, -1, -1, -1, -1, -1, -1, -1 },  // 82
+    {  1,  9,  4,  1,  4,  7,  1,  7,  3, 10,  6,  5, -1, -1, -1, -1 },  // 83
+    {  2,  5,  1,  2,  6,  5,  7,  8,  4, -1, -1, -1, -1, -1, -1, -1 },  // 84
+    {  0,  7,  3,  0,  4,  7,  1,  2,  6,  1,  6,  5, -1, -1, -1, -1 },  // 85
+    {  0,  2,  6,  0,  6,  5,  0,  5,  9,  4,  7,  8, -1, -1, -1, -1 },  // 86
+    {  6,  5,  9,  4,  7,  3,  9,  4,  3,  6,  9,  3,  2,  6,  3, -1 },  // 87
+    {  2,  3, 11,  7,  8,  4, 10,  6,  5, -1, -1, -1, -1, -1, -1, -1 },  // 88
+    {  4,  7, 11,  4, 11,  2,  4,  2,  0, 10,  6,  5, -1, -1, -1, -1 },  // 89
+    {  8,  4,  7,  5, 10,  6,  1,  9,  0,  2,  3, 11, -1, -1, -1, -1 },  // 90
+    { 10,  6,  5,  2,  1, 11, 11,  1,  9, 11,  9,  7,  7,  9,  4, -1 },  // 91
+    {  3, 11,  6,  3,  6,  5,  3,  5,  1,  7,  8,  4, -1, -1, -1, -1 },  // 92
+    {  4,  7, 11,  6,  5,  1, 11,  6,  1,  4, 11,  1,  0,  4,  1, -1 },  // 93
+    {  8,  4,  7,  0,  3,  9,  9,  3, 11,  9, 11,  5,  5, 11,  6, -1 },  // 94
+    {  6,  5,  9, 11,  6,  9,  7, 11,  9,  4,  7,  9, -1, -1, -1, -1 },  // 95
+    {  9,  6,  4,  9, 10,  6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 96
+    {  6,  9, 10,  6,  4,  9,  8,  3,  0, -1, -1, -1, -1, -1, -1, -1 },  // 97
+    { 10,  0,  1, 10,  6,  0,  6,  4,  0, -1, -1, -1, -1, -1, -1, -1 },  // 98
+    {  4,  8,  6,  6,  8,  3,  6,  3, 10, 10,  3,  1, -1, -1, -1, -1 },  // 99
+    {  1,  4,  9,  1,  2,  4,  2,  6,  4, -1, -1, -1, -1, -1, -1, -1 },  // 100
+    {  8,  3,  0,  2,  6,  4,  2,  4,  9,  2,  9,  1, -1, -1, -1, -1 },  // 101
+    {  6,  4,  2,  2,  4,  0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 102
+    {  6,  4,  8,  6,  8,  3,  6,  3,  2, -1, -1, -1, -1, -1, -1, -1 },  // 103
+    {  9,  6,  4,  9, 10,  6,  2,  3, 11, -1, -1, -1, -1, -1, -1, -1 },  // 104
+    {  2,  8, 11,  2,  0,  8, 10,  6,  4, 10,  4,  9, -1, -1, -1, -1 },  // 105
+    {  0,  1, 10,  0, 10,  6,  0,  6,  4,  2,  3, 11, -1, -1, -1, -1 },  // 106
+    {  1, 10,  6,  6,  4,  8,  1,  6,  8,  8, 11,  2,  1,  8,  2, -1 },  // 107
+    {  3,  9,  1,  3,  4,  9,  3, 11,  4, 11,  6,  4, -1, -1, -1, -1 },  // 108
+    {  4,  9,  1,  6,  4,  1, 11,  6,  1,  8, 11,  1,  0,  8,  1, -1 },  // 109
+    {  6,  4,  0,  6,  0,  3, 11,  6,  3, -1, -1, -1, -1, -1, -1, -1 },  // 110
+    { 11,  6,  4,  8, 11,  4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 111
+    {  7, 10,  6,  7,  8, 10,  8,  9, 10, -1, -1, -1, -1, -1, -1, -1 },  // 112
+    { 10,  0,  9, 10,  3,  0, 10,  6,  3,  6,  7,  3, -1, -1, -1, -1 },  // 113
+    {  6,  7, 10, 10,  7,  8, 10,  8,  1,  1,  8,  0, -1, -1, -1, -1 },  // 114
+    {  7,  3,  1,  7,  1, 10,  6,  7, 10, -1, -1, -1, -1, -1, -1, -1 },  // 115
+    {  6,  7,  2,  2,  7,  8,  2,  8,  1,  1,  8,  9, -1, -1, -1, -1 },  // 116
+    {  9,  1,  2,  9,  2,  6,  9,  6,  7,  9,  7,  3,  9,  3,  0, -1 },  // 117
+    {  0,  2,  6,  0,  6,  7,  8,  0,  7, -1, -1, -1, -1, -1, -1, -1 },  // 118
+    {  3,  2,  6,  7,  3,  6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 119
+    {  2,  3, 11,  6,  7,  8,  6,  8,  9,  6,  9, 10, -1, -1, -1, -1 },  // 120
+    {  9, 10,  6,  9,  6,  7,  9,  7, 11,  9, 11,  2,  9,  2,  0, -1 },  // 121
+    { 11,  2,  3,  6,  7, 10, 10,  7,  8, 10,  8,  1,  1,  8,  0, -1 },  // 122
+    { 10,  6,  7,  1, 10,  7,  7, 11,  2,  1,  7,  2, -1, -1, -1, -1 },  // 123
+    {  3, 11,  6,  7,  8,  9,  6,  7,  9,  3,  6,  9,  1,  3,  9, -1 },  // 124
+    {  0,  9,  1, 11,  6,  7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 125
+    {  0,  3, 11,  0, 11,  6,  0,  6,  7,  0,  7,  8, -1, -1, -1, -1 },  // 126
+    { 11,  6,  7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 127
+    {  7,  6, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 128
+    {  6, 11,  7,  3,  0,  8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 129
+    {  7,  6, 11,  1,  9,  0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 130
+    {  9,  3,  1,  9,  8,  3,  7,  6, 11, -1, -1, -1, -1, -1, -1, -1 },  // 131
+    {  7,  6, 11, 10,  1,  2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 132
+    {  8,  3,  0,  1,  2, 10, 11,  7,  6, -1, -1, -1, -1, -1, -1, -1 },  // 133
+    {  0, 10,  9,  0,  2, 10, 11,  7,  6, -1, -1, -1, -1, -1, -1, -1 },  // 134
+    { 10,  9,  8, 10,  8,  3, 10,  3,  2, 11,  7,  6, -1, -1, -1, -1 },  // 135
+    {  6,  3,  7,  6,  2,  3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 136
+    {  7,  0,  8,  7,  6,  0,  6,  2,  0, -1, -1, -1, -1, -1, -1, -1 },  // 137
+    {  6,  3,  7,  6,  2,  3,  1,  9,  0, -1, -1, -1, -1, -1, -1, -1 },  // 138
+    {  2,  1,  6,  6,  1,  9,  6,  9,  7,  7,  9,  8, -1, -1, -1, -1 },  // 139
+    { 10,  7,  6, 10,  1,  7,  1,  3,  7, -1, -1, -1, -1, -1, -1, -1 },  // 140
+    {  6, 10,  7,  7, 10,  1,  7,  1,  8,  8,  1,  0, -1, -1, -1, -1 },  // 141
+    {  9,  6, 10,  9,  7,  6,  9,  0,  7,  0,  3,  7, -1, -1, -1, -1 },  // 142
+    { 10,  9,  8, 10,  8,  7,  6, 10,  7, -1, -1, -1, -1, -1, -1, -1 },  // 143
+    {  4, 11,  8,  4,  6, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 144
+    {  3,  6, 11,  3,  0,  6,  0,  4,  6, -1, -1, -1, -1, -1, -1, -1 },  // 145
+    { 11,  4,  6, 11,  8,  4,  0,  1,  9, -1, -1, -1, -1, -1, -1, -1 },  // 146
+    {  1, 11,  3,  1,  6, 11,  1,  9,  6,  9,  4,  6, -1, -1, -1, -1 },  // 147
+    {  4, 11,  8,  4,  6, 11, 10,  1,  2, -1, -1, -1, -1, -1, -1, -1 },  // 148
+    {  4,  6, 11,  4, 11,  3,  4,  3,  0,  1,  2, 10, -1, -1, -1, -1 },  // 149
+    {  4, 11,  8,  4,  6, 11,  9,  0,  2,  9,  2, 10, -1, -1, -1, -1 },  // 150
+    {  6, 11,  3,  4,  6,  3,  9,  4,  3, 10,  9,  3,  2, 10,  3, -1 },  // 151
+    {  8,  2,  3,  8,  4,  2,  4,  6,  2, -1, -1, -1, -1, -1, -1, -1 },  // 152
+    {  4,  6,  0,  0,  6,  2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 153
+    {  0,  1,  9,  2,  3,  8,  2,  8,  4,  2,  4,  6, -1, -1, -1, -1 },  // 154
+    {  4,  6,  2,  4,  2,  1,  9,  4,  1, -1, -1, -1, -1, -1, -1, -1 },  // 155
+    {  6, 10,  4,  4, 10,  1,  4,  1,  8,  8,  1,  3, -1, -1, -1, -1 },  // 156
+    {  0,  4,  6,  0,  6, 10,  1,  0, 10, -1, -1, -1, -1, -1, -1, -1 },  // 157
+    {  8,  4,  6,  3,  8,  6,  6, 10,  9,  3,  6,  9,  0,  3,  9, -1 },  // 158
+    {  6, 10,  9,  4,  6,  9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 159
+    {  9,  5,  4,  6, 11,  7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 160
+    {  8,  3,  0,  9,  5,  4, 11,  7,  6, -1, -1, -1, -1, -1, -1, -1 },  // 161
+    {  1,  4,  0,  1,  5,  4,  6, 11,  7, -1, -1, -1, -1, -1, -1, -1 },  // 162
+    {  1,  5,  4,  1,  4,  8,  1,  8,  3, 11,  7,  6, -1, -1, -1, -1 },  // 163
+    {  1,  2, 10,  9,  5,  4, 11,  7,  6, -1, -1, -1, -1, -1, -1, -1 },  // 164
+    {  3,  0,  8,  9,  5,  4, 10,  1,  2,  6, 11,  7, -1, -1, -1, -1 },  // 165
+    {  0,  2, 10,  0, 10,  5,  0,  5,  4, 11,  7,  6, -1, -1, -1, -1 },  // 166
+    {  7,  6, 11,  4,  8,  5,  5,  8,  3,  5,  3, 10, 10,  3,  2, -1 },  // 167
+    {  3,  6,  2,  3,  7,  6,  4,  9,  5, -1, -1, -1, -1, -1, -1, -1 },  // 168
+    {  8,  7,  6,  8,  6,  2,  8,  2,  0,  9,  5,  4, -1, -1, -1, -1 },  // 169
+    {  6,  3,  7,  6,  2,  3,  5,  4,  0,  5,  0,  1, -1, -1, -1, -1 },  // 170
+    {  5,  4,  8,  7,  6,  2,  8,  7,  2,  5,  8,  2,  1,  5,  2, -1 },  // 171
+    {  3,  7,  6,  3,  6, 10,  3, 10,  1,  9,  5,  4, -1, -1, -1, -1 },  // 172
+    {  5,  4,  9,  6, 10,  7,  7, 10,  1,  7,  1,  8,  8,  1,  0, -1 },  // 173
+    {  0,  3,  7,  0,  7,  6,  0,  6, 10,  0, 10,  5,  0,  5,  4, -1 },  // 174
+    {  8,  7,  6,  8,  6, 10,  8, 10,  5,  8,  5,  4, -1, -1, -1, -1 },  // 175
+    {  6,  9,  5,  6, 11,  9, 11,  8,  9, -1, -1, -1, -1, -1, -1, -1 },  // 176
+    {  0,  9,  3,  3,  9,  5,  3,  5, 11, 11,  5,  6, -1, -1, -1, -1 },  // 177
+    {  5,  6,  1,  1,  6, 11,  1, 11,  0,  0, 11,  8, -1, -1, -1, -1 },  // 178
+    {  3,  1,  5,  3,  5,  6, 11,  3,  6, -1, -1, -1, -1, -1, -1, -1 },  // 179
+    {  1,  2, 10,  5,  6, 11,  5, 11,  8,  5,  8,  9, -1, -1, -1, -1 },  // 180
+    {  1,  2, 10,  0,  9,  3,  3,  9,  5,  3,  5, 11, 11,  5,  6, -1 },  // 181
+    {  0,  2, 10,  0, 10,  5,  0,  5,  6,  0,  6, 11,  0, 11,  8, -1 },  // 182
+    {  6, 11,  3,  5,  6,  3, 10,  5,  3,  2, 10,  3, -1, -1, -1, -1 },  // 183
+    {  9,  3,  8,  9,  2,  3,  9,  5,  2,  5,  6,  2, -1, -1, -1, -1 },  // 184
+    {  6,  2,  0,  6,  0,  9,  5,  6,  9, -1, -1, -1, -1, -1, -1, -1 },  // 185
+    {  2,  3,  8,  6,  2,  8,  5,  6,  8,  1,  5,  8,  0,  1,  8, -1 },  // 186
+    {  2,  1,  5,  6,  2,  5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 187
+    {  3,  8,  9,  3,  9,  5,  3,  5,  6,  3,  6, 10,  3, 10,  1, -1 },  // 188
+    {  9,  5,  6,  0,  9,  6,  6, 10,  1,  0,  6,  1, -1, -1, -1, -1 },  // 189
+    {  6, 10,  5,  8,  0,  3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 190
+    {  6, 10,  5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 191
+    {  7, 10, 11,  7,  5, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 192
+    { 10,  7,  5, 10, 11,  7,  3,  0,  8, -1, -1, -1, -1, -1, -1, -1 },  // 193
+    {  7, 10, 11,  7,  5, 10,  9,  0,  1, -1, -1, -1, -1, -1, -1, -1 },  // 194
+    {  3,  9,  8,  3,  1,  9, 11,  7,  5, 11,  5, 10, -1, -1, -1, -1 },  // 195
+    { 11,  1,  2, 11,  7,  1,  7,  5,  1, -1, -1, -1, -1, -1, -1, -1 },  // 196
+    {  8,  3,  0,  1,  2, 11,  1, 11,  7,  1,  7,  5, -1, -1, -1, -1 },  // 197
+    {  2, 11,  0,  0, 11,  7,  0,  7,  9,  9,  7,  5, -1, -1, -1, -1 },  // 198
+    {  2, 11,  7,  7,  5,  9,  2,  7,  9,  9,  8,  3,  2,  9,  3, -1 },  // 199
+    {  2,  5, 10,  2,  3,  5,  3,  7,  5, -1, -1, -1, -1, -1, -1, -1 },  // 200
+    {  5,  8,  7,  5,  0,  8,  5, 10,  0, 10,  2,  0, -1, -1, -1, -1 },  // 201
+    {  0,  1,  9,  3,  7,  5,  3,  5, 10,  3, 10,  2, -1, -1, -1, -1 },  // 202
+    {  5, 10,  2,  7,  5,  2,  8,  7,  2,  9,  8,  2,  1,  9,  2, -1 },  // 203
+    {  1,  3,  5,  5,  3,  7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 204
+    {  7,  5,  1,  7,  1,  0,  8,  7,  0, -1, -1, -1, -1, -1, -1, -1 },  // 205
+    {  3,  7,  5,  3,  5,  9,  0,  3,  9, -1, -1, -1, -1, -1, -1, -1 },  // 206
+    {  5,  9,  8,  7,  5,  8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 207
+    {  5,  8,  4,  5, 10,  8, 10, 11,  8, -1, -1, -1, -1, -1, -1, -1 },  // 208
+    {  4,  5,  0,  0,  5, 10,  0, 10,  3,  3, 10, 11, -1, -1, -1, -1 },  // 209
+    {  0,  1,  9,  4,  5, 10,  4, 10, 11,  4, 11,  8, -1, -1, -1, -1 },  // 210
+    {  4,  5, 10, 10, 11,  3,  4, 10,  3,  9,  4,  3,  1,  9,  3, -1 },  // 211
+    {  1,  4,  5,  1,  8,  4,  1,  2,  8,  2, 11,  8, -1, -1, -1, -1 },  // 212
+    {  4,  5,  1,  4,  1,  2,  4,  2, 11,  4, 11,  3,  4,  3,  0, -1 },  // 213
+    {  8,  4,  5, 11,  8,  5,  2, 11,  5,  2,  5,  9,  0,  2,  9, -1 },  // 214
+    {  4,  5,  9,  3,  2, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 215
+    {  4,  5,  8,  8,  5, 10,  8, 10,  3,  3, 10,  2, -1, -1, -1, -1 },  // 216
+    {  2,  0,  4,  2,  4,  5, 10,  2,  5, -1, -1, -1, -1, -1, -1, -1 },  // 217
+    {  9,  0,  1,  4,  5,  8,  8,  5, 10,  8, 10,  3,  3, 10,  2, -1 },  // 218
+    {  5, 10,  2,  4,  5,  2,  9,  4,  2,  1,  9,  2, -1, -1, -1, -1 },  // 219
+    {  5,  1,  3,  5,  3,  8,  4,  5,  8, -1, -1, -1, -1, -1, -1, -1 },  // 220
+    {  4,  5,  1,  0,  4,  1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 221
+    {  8,  4,  5,  3,  8,  5,  3,  5,  9,  0,  3,  9, -1, -1, -1, -1 },  // 222
+    {  4,  5,  9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 223
+    {  4, 11,  7,  4,  9, 11,  9, 10, 11, -1, -1, -1, -1, -1, -1, -1 },  // 224
+    {  8,  3,  0,  4,  9, 10,  4, 10, 11,  4, 11,  7, -1, -1, -1, -1 },  // 225
+    { 11,  1, 10, 11,  0,  1, 11,  7,  0,  7,  4,  0, -1, -1, -1, -1 },  // 226
+    {  1, 10, 11,  1, 11,  7,  1,  7,  4,  1,  4,  8,  1,  8,  3, -1 },  // 227
+    {  2, 11,  1,  1, 11,  7,  1,  7,  9,  9,  7,  4, -1, -1, -1, -1 },  // 228
+    {  3,  0,  8,  2, 11,  1,  1, 11,  7,  1,  7,  9,  9,  7,  4, -1 },  // 229
+    {  4,  0,  2,  4,  2, 11,  7,  4, 11, -1, -1, -1, -1, -1, -1, -1 },  // 230
+    { 11,  7,  4,  2, 11,  4,  4,  8,  3,  2,  4,  3, -1, -1, -1, -1 },  // 231
+    { 10,  2,  9,  9,  2,  3,  9,  3,  4,  4,  3,  7, -1, -1, -1, -1 },  // 232
+    {  7,  4,  9,  9, 10,  2,  7,  9,  2,  8,  7,  2,  0,  8,  2, -1 },  // 233
+    { 10,  2,  3,  3,  7,  4, 10,  3,  4,  1, 10,  4,  0,  1,  4, -1 },  // 234
+    { 10,  2,  1,  4,  8,  7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 235
+    {  1,  3,  7,  1,  7,  4,  9,  1,  4, -1, -1, -1, -1, -1, -1, -1 },  // 236
+    {  4,  9,  1,  7,  4,  1,  8,  7,  1,  0,  8,  1, -1, -1, -1, -1 },  // 237
+    {  3,  7,  4,  3,  4,  0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 238
+    {  4,  8,  7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 239
+    { 10, 11,  9,  9, 11,  8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 240
+    {  9, 10, 11,  9, 11,  3,  0,  9,  3, -1, -1, -1, -1, -1, -1, -1 },  // 241
+    { 10, 11,  8, 10,  8,  0,  1, 10,  0, -1, -1, -1, -1, -1, -1, -1 },  // 242
+    {  1, 10, 11,  3,  1, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 243
+    { 11,  8,  9, 11,  9,  1,  2, 11,  1, -1, -1, -1, -1, -1, -1, -1 },  // 244
+    {  9,  1,  2,  9,  2, 11,  9, 11,  3,  9,  3,  0, -1, -1, -1, -1 },  // 245
+    {  8,  0,  2, 11,  8,  2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 246
+    {  3,  2, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 247
+    {  8,  9, 10,  8, 10,  2,  3,  8,  2, -1, -1, -1, -1, -1, -1, -1 },  // 248
+    {  0,  9, 10,  2,  0, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 249
+    {  2,  3,  8, 10,  2,  8,  1, 10,  8,  0,  1,  8, -1, -1, -1, -1 },  // 250
+    {  2,  1, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 251
+    {  9,  1,  3,  8,  9,  3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 252
+    {  0,  9,  1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 253
+    {  8,  0,  3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },  // 254
+    { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 }  // 255
+};
+
+#endif /* MarchingCubesTables_hpp */
@@ -0,0 +1,353 @@
+//
+//  MeshWriter.cpp
+//  hoppe
+//
+//  Created by apple on 16/10/2026.
+//
+
+#include "MeshWriter.hpp"
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <cctype>
+#include "hoppe_common.hpp"
+
+// Buffers are handed to the file once they grow past this size
+static constexpr std::size_t flush_bytes = 8 << 20;
+
+// Elements formatted between two checks of the buffer size
+static constexpr std::size_t block_elements = 1 << 16;
+
+/// Appends the fixed size header of `format`. PLY counts are padded to a
+/// fixed width so the header can be rewritten in place once they are known.
+static auto append_header(std::vector<char> &buffer, MeshFormat format,
+                          std::size_t num_vertices, std::size_t num_triangles) -> void {
+    if (format == MeshFormat::ply) {
+        char header[256];
+        const auto length = snprintf(header, sizeof(header),
+                                     "ply\n"
+                                     "format binary_little_endian 1.0\n"
+                                     "element vertex %012lu\n"
+                                     "property float x\n"
+                                     "property float y\n"
+                                     "property float z\n"
+                                     "element face %012lu\n"
+                                     "property list uchar int vertex_indices\n"
+                                     "end_header\n",
+                                     num_vertices, num_triangles);
+        buffer.insert(buffer.end(), header, header + length);
+    } else if (format == MeshFormat::stl) {
+        // Must not start with "solid", which marks ASCII STL
+        char header[80] = "binary STL written by hoppe";
+        const auto count = (std::uint32_t) num_triangles;
+        buffer.insert(buffer.end(), header, header + sizeof(header));
+        buffer.insert(buffer.end(), (const char *) &count, (const char *) &count + sizeof(count));
+    }
+}
+
+static auto append_obj_vertices(std::vector<char> &buffer, const cv::Point3f *vertices, std::size_t count) -> void {
+    char line[96];
+    for (auto i = 0ul; i < count; i++) {
+        const auto length = snprintf(line, sizeof(line), "v %g %g %g\n", vertices[i].x, vertices[i].y, vertices[i].z);
+        buffer.insert(buffer.end(), line, line + length);
+    }
+}
+
+static auto append_obj_faces(std::vector<char> &buffer, const std::uint32_t *indices, std::size_t num_triangles) -> void {
+    char line[48];
+    for (auto i = 0ul; i < num_triangles * 3; i += 3) {
+        const auto length = snprintf(line, sizeof(line), "f %u %u %u\n",
+                                     indices[i] + 1, indices[i + 1] + 1, indices[i + 2] + 1);
+        buffer.insert(buffer.end(), line, line + length);
+    }
+}
+
+static auto append_ply_faces(std::vector<char> &buffer, const std::uint32_t *indices, std::size_t num_triangles) -> void {
+    constexpr auto face_size = 1 + 3 * sizeof(std::int32_t);
+    const auto old_size = buffer.size();
+    buffer.resize(old_size + num_triangles * face_size);
+    auto *it = buffer.data() + old_size;
+    for (auto i = 0ul; i < num_triangles * 3; i += 3) {
+        *it++ = 3;
+        for (auto k = 0; k < 3; k++) {
+            const auto index = (std::int32_t) indices[i + k];
+            std::memcpy(it, &index, sizeof(index));
+            it += sizeof(index);
+        }
+    }
+}
+
+/// @param first_vertex id of `vertices[0]`
+static auto append_stl_triangles(std::vector<char> &buffer, const cv::Point3f *vertices, std::size_t first_vertex,
+                                 const std::uint32_t *indices, std::size_t num_triangles) -> void {
+    constexpr auto triangle_size = 12 * sizeof(float) + sizeof(std::uint16_t);
+    const auto old_size = buffer.size();
+    buffer.resize(old_size + num_triangles * triangle_size);
+    auto *it = buffer.data() + old_size;
+    for (auto i = 0ul; i < num_triangles * 3; i += 3) {
+        const auto &a = vertices[indices[i] - first_vertex];
+        const auto &b = vertices[indices[i + 1] - first_vertex];
+        const auto &c = vertices[indices[i + 2] - first_vertex];
+        auto normal = (b - a).cross(c - a);
+        const auto length = std::sqrt(normal.dot(normal));
+        normal = length > 0.0f ? normal * (1.0f / length) : cv::Point3f();
+        const float values[12] = { normal.x, normal.y, normal.z, a.x, a.y, a.z, b.x, b.y, b.z, c.x, c.y, c.z };
+        const std::uint16_t attributes = 0;
+        std::memcpy(it, values, sizeof(values));
+        std::memcpy(it + sizeof(values), &attributes, sizeof(attributes));
+        it += triangle_size;
+    }
+}
+
+MeshWriter::MeshWriter(const std::string path, MeshFormat format, std::size_t max_queued_chunks) :
+    path(path),
+    format(format),
+    max_queued_chunks(std::max((std::size_t) 1, max_queued_chunks)) {
+    file.open(path, std::ios::binary);
+    if (!file) {
+        HOPPE_LOG("WARNING! Could not open %s for writing", path.c_str());
+    }
+    if (format == MeshFormat::ply) {
+        faces_path = path + ".faces";
+        faces_file.open(faces_path, std::ios::binary);
+        if (!faces_file) {
+            HOPPE_LOG("WARNING! Could not open %s for writing", faces_path.c_str());
+        }
+    }
+    write_header();
+    writer = std::thread(&MeshWriter::write_loop, this);
+}
+
+MeshWriter::~MeshWriter() {
+    finish();
+}
+
+auto MeshWriter::format_for(const std::string &path) -> MeshFormat {
+    const auto dot = path.find_last_of('.');
+    if (dot == std::string::npos) {
+        return MeshFormat::obj;
+    }
+    auto extension = path.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [] (unsigned char c) { return std::tolower(c); });
+    if (extension == "ply") {
+        return MeshFormat::ply;
+    } else if (extension == "stl") {
+        return MeshFormat::stl;
+    }
+    return MeshFormat::obj;
+}
+
+auto MeshWriter::write(const std::string &path,
+                       MeshFormat format,
+                       const std::vector<cv::Point3f> &vertices,
+                       const std::vector<std::uint32_t> &indices) -> bool {
+    const auto begin = std::chrono::steady_clock::now();
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        HOPPE_LOG("WARNING! Could not open %s for writing", path.c_str());
+        return false;
+    }
+    const auto num_vertices = vertices.size();
+    const auto num_triangles = indices.size() / 3;
+    auto bytes = 0ul;
+    std::vector<char> buffer;
+    buffer.reserve(flush_bytes + (block_elements << 7));
+    const auto flush = [&] () {
+        out.write(buffer.data(), buffer.size());
+        bytes += buffer.size();
+        buffer.clear();
+    };
+    const auto flush_if_full = [&] () {
+        if (buffer.size() >= flush_bytes) {
+            flush();
+        }
+    };
+
+    append_header(buffer, format, num_vertices, num_triangles);
+    if (format == MeshFormat::obj) {
+        for (auto i = 0ul; i < num_vertices; i += block_elements) {
+            append_obj_vertices(buffer, &vertices[i], std::min(block_elements, num_vertices - i));
+            flush_if_full();
+        }
+        for (auto i = 0ul; i < num_triangles; i += block_elements) {
+            append_obj_faces(buffer, &indices[i * 3], std::min(block_elements, num_triangles - i));
+            flush_if_full();
+        }
+    } else if (format == MeshFormat::ply) {
+        // cv::Point3f is three packed floats, the PLY vertex layout
+        flush();
+        out.write((const char *) vertices.data(), num_vertices * sizeof(cv::Point3f));
+        bytes += num_vertices * sizeof(cv::Point3f);
+        for (auto i = 0ul; i < num_triangles; i += block_elements) {
+            append_ply_faces(buffer, &indices[i * 3], std::min(block_elements, num_triangles - i));
+            flush_if_full();
+        }
+    } else {
+        for (auto i = 0ul; i < num_triangles; i += block_elements) {
+            append_stl_triangles(buffer, vertices.data(), 0, &indices[i * 3], std::min(block_elements, num_triangles - i));
+            flush_if_full();
+        }
+    }
+    flush();
+    out.close();
+
+    if (out.fail()) {
+        HOPPE_LOG("WARNING! Failed to write mesh to %s", path.c_str());
+        return false;
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+    HOPPE_LOG("Exported %lu vertices and %lu triangles to %s: %.2f MB in %.3f s, %.2f MB/s",
+              num_vertices, num_triangles, path.c_str(), bytes / 1048576.0, elapsed.count(),
+              bytes / 1048576.0 / std::max(elapsed.count(), 1e-9));
+    return true;
+}
+
+auto MeshWriter::sink() -> MeshSink {
+    return [this] (std::vector<cv::Point3f> &&vertices,
+                   std::vector<std::uint32_t> &&indices) {
+        push(std::move(vertices), std::move(indices));
+    };
+}
+
+auto MeshWriter::push(std::vector<cv::Point3f> &&vertices,
+                      std::vector<std::uint32_t> &&indices) -> void {
+    std::unique_lock<std::mutex> lock(mutex);
+    space_ready.wait(lock, [&] () {
+        return queue.size() < max_queued_chunks;
+    });
+    queue.push_back(Chunk { std::move(vertices), std::move(indices) });
+    lock.unlock();
+    chunk_ready.notify_one();
+}
+
+auto MeshWriter::write_loop() -> void {
+    while (true) {
+        Chunk chunk;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            chunk_ready.wait(lock, [&] () {
+                return !queue.empty() || closing;
+            });
+            if (queue.empty()) {
+                return;
+            }
+            chunk = std::move(queue.front());
+            queue.pop_front();
+        }
+        space_ready.notify_one();
+        write_chunk(chunk);
+    }
+}
+
+auto MeshWriter::write_chunk(const Chunk &chunk) -> void {
+    const auto begin = std::chrono::steady_clock::now();
+    const auto num_chunk_vertices = chunk.vertices.size();
+    const auto num_chunk_triangles = chunk.indices.size() / 3;
+    if (format == MeshFormat::obj) {
+        // Vertices of a chunk come before the faces using them, as OBJ expects
+        for (auto i = 0ul; i < num_chunk_vertices; i += block_elements) {
+            append_obj_vertices(buffer, &chunk.vertices[i], std::min(block_elements, num_chunk_vertices - i));
+            flush(file);
+        }
+        for (auto i = 0ul; i < num_chunk_triangles; i += block_elements) {
+            append_obj_faces(buffer, &chunk.indices[i * 3], std::min(block_elements, num_chunk_triangles - i));
+            flush(file);
+        }
+    } else if (format == MeshFormat::ply) {
+        // Only faces go through the buffer, into their own file
+        file.write((const char *) chunk.vertices.data(), num_chunk_vertices * sizeof(cv::Point3f));
+        bytes_written += num_chunk_vertices * sizeof(cv::Point3f);
+        for (auto i = 0ul; i < num_chunk_triangles; i += block_elements) {
+            append_ply_faces(buffer, &chunk.indices[i * 3], std::min(block_elements, num_chunk_triangles - i));
+            flush(faces_file);
+        }
+    } else {
+        // Triangles reach back one chunk at most, so older vertices are dropped
+        stl_window.erase(stl_window.begin(), stl_window.begin() + (stl_previous_chunk - stl_window_begin));
+        stl_window_begin = stl_previous_chunk;
+        stl_previous_chunk = num_vertices;
+        stl_window.insert(stl_window.end(), chunk.vertices.begin(), chunk.vertices.end());
+        const auto window_end = stl_window_begin + stl_window.size();
+        const auto outside = std::find_if(chunk.indices.begin(), chunk.indices.end(), [&] (std::uint32_t index) {
+            return index < stl_window_begin || index >= window_end;
+        });
+        if (outside != chunk.indices.end()) {
+            HOPPE_LOG("WARNING! Vertex %u is not in the last two chunks, dropping %lu STL triangles",
+                      *outside, num_chunk_triangles);
+            file.setstate(std::ios::failbit);
+        } else {
+            for (auto i = 0ul; i < num_chunk_triangles; i += block_elements) {
+                append_stl_triangles(buffer, stl_window.data(), stl_window_begin, &chunk.indices[i * 3],
+                                     std::min(block_elements, num_chunk_triangles - i));
+                flush(file);
+            }
+        }
+    }
+    num_vertices += num_chunk_vertices;
+    num_triangles += num_chunk_triangles;
+    write_time += std::chrono::steady_clock::now() - begin;
+}
+
+auto MeshWriter::flush(std::ofstream &out, bool force) -> void {
+    if (force || buffer.size() >= flush_bytes) {
+        out.write(buffer.data(), buffer.size());
+        bytes_written += buffer.size();
+        buffer.clear();
+    }
+}
+
+auto MeshWriter::write_header() -> void {
+    std::vector<char> header;
+    append_header(header, format, num_vertices, num_triangles);
+    file.write(header.data(), header.size());
+    if (!finished) {
+        bytes_written += header.size();
+    }
+}
+
+auto MeshWriter::finish() -> bool {
+    if (finished) {
+        return !file.fail();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closing = true;
+    }
+    chunk_ready.notify_all();
+    if (writer.joinable()) {
+        writer.join();
+    }
+    finished = true;
+
+    const auto begin = std::chrono::steady_clock::now();
+    flush(format == MeshFormat::ply ? faces_file : file, true);
+    if (format == MeshFormat::ply) {
+        faces_file.close();
+        std::ifstream faces(faces_path, std::ios::binary);
+        buffer.resize(flush_bytes);
+        while (faces) {
+            faces.read(buffer.data(), buffer.size());
+            file.write(buffer.data(), faces.gcount());
+        }
+        faces.close();
+        std::remove(faces_path.c_str());
+    }
+    // Rewrite the header now that the counts are known
+    file.seekp(0);
+    write_header();
+    file.close();
+    std::vector<char>().swap(buffer);
+    std::vector<cv::Point3f>().swap(stl_window);
+    write_time += std::chrono::steady_clock::now() - begin;
+
+    if (file.fail()) {
+        HOPPE_LOG("WARNING! Failed to write mesh to %s", path.c_str());
+        return false;
+    }
+    HOPPE_LOG("Wrote %lu vertices and %lu triangles to %s: %.2f MB, %.3f s spent writing, %.2f MB/s",
+              num_vertices, num_triangles, path.c_str(), bytes_written / 1048576.0, write_time.count(),
+              bytes_written / 1048576.0 / std::max(write_time.count(), 1e-9));
+    return true;
+}
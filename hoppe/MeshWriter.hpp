@@ -0,0 +1,114 @@
+//
+//  MeshWriter.hpp
+//  hoppe
+//
+//  Created by apple on 16/10/2026.
+//
+
+#ifndef MeshWriter_hpp
+#define MeshWriter_hpp
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <opencv2/core.hpp>
+#include "CubeMarcher.hpp"
+
+enum class MeshFormat {
+    obj,
+    ply,    // binary little endian
+    stl     // binary
+};
+
+/// Writes a mesh that arrives in chunks to disk on a background thread, so
+/// formatting and I/O overlap with marching. Chunks wait in a bounded queue
+/// and the producer blocks while it is full, which keeps memory bounded
+/// when the disk is slower than the marcher.
+class MeshWriter {
+public:
+    /// @param path file to write
+    /// @param format file format
+    /// @param max_queued_chunks chunks that may wait before the producer blocks
+    MeshWriter(const std::string path, MeshFormat format, std::size_t max_queued_chunks = 16);
+
+    ~MeshWriter();
+
+    MeshWriter(const MeshWriter &) = delete;
+    auto operator=(const MeshWriter &) -> MeshWriter & = delete;
+
+    /// Picks the format from the extension of `path`: .ply, .stl, or OBJ otherwise.
+    static auto format_for(const std::string &path) -> MeshFormat;
+
+    /// Writes a whole mesh at once from large buffers and reports the throughput.
+    /// @param path file to write
+    /// @param format file format
+    /// @param vertices vertex positions
+    /// @param indices three vertex indices per triangle
+    /// @returns true if the whole mesh was written
+    static auto write(const std::string &path,
+                      MeshFormat format,
+                      const std::vector<cv::Point3f> &vertices,
+                      const std::vector<std::uint32_t> &indices) -> bool;
+
+    /// Sink to hand to `CubeMarcher::march`. Chunks are moved into the queue.
+    auto sink() -> MeshSink;
+
+    /// Waits for every queued chunk and completes the file.
+    /// @returns true if the whole mesh was written
+    auto finish() -> bool;
+
+private:
+    struct Chunk {
+        std::vector<cv::Point3f> vertices;
+        std::vector<std::uint32_t> indices;
+    };
+
+    auto push(std::vector<cv::Point3f> &&vertices,
+              std::vector<std::uint32_t> &&indices) -> void;
+
+    auto write_loop() -> void;
+
+    auto write_chunk(const Chunk &chunk) -> void;
+
+    /// Writes `buffer` to `out` and empties it, once it holds `flush_bytes` or
+    /// when `force` is set.
+    auto flush(std::ofstream &out, bool force = false) -> void;
+
+    auto write_header() -> void;
+
+    std::string path;
+    MeshFormat format;
+    std::size_t max_queued_chunks;
+
+    std::ofstream file;
+    // Binary PLY wants every vertex before the first face, so faces are
+    // spilled here and appended to `file` at the end
+    std::ofstream faces_file;
+    std::string faces_path;
+    // STL repeats positions in every triangle, so the vertices of the
+    // previous and the current chunk are kept, starting at id `stl_window_begin`
+    std::vector<cv::Point3f> stl_window;
+    std::size_t stl_window_begin = 0;
+    std::size_t stl_previous_chunk = 0;
+    std::vector<char> buffer;
+
+    std::deque<Chunk> queue;
+    std::mutex mutex;
+    std::condition_variable chunk_ready, space_ready;
+    bool closing = false;
+    bool finished = false;
+    std::thread writer;
+
+    std::size_t num_vertices = 0;
+    std::size_t num_triangles = 0;
+    // Time the writer thread spent formatting and writing
+    std::size_t bytes_written = 0;
+    std::chrono::duration<double> write_time { 0.0 };
+};
+
+#endif /* MeshWriter_hpp */
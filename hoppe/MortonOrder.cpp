@@ -0,0 +1,104 @@
+//
+//  MortonOrder.cpp
+//  hoppe
+//
+//  Created by apple on 16/10/2026.
+//
+
+#include "MortonOrder.hpp"
+#include <algorithm>
+
+/// Spreads the low 21 bits of `v` two bits apart.
+static auto spread_bits(std::uint64_t v) -> std::uint64_t {
+    v &= 0x1fffff;
+    v = (v | v << 32) & 0x1f00000000ffffull;
+    v = (v | v << 16) & 0x1f0000ff0000ffull;
+    v = (v | v << 8) & 0x100f00f00f00f00full;
+    v = (v | v << 4) & 0x10c30c30c30c30c3ull;
+    v = (v | v << 2) & 0x1249249249249249ull;
+    return v;
+}
+
+auto morton_code(std::uint32_t x, std::uint32_t y, std::uint32_t z) -> std::uint64_t {
+    return spread_bits(x) | spread_bits(y) << 1 | spread_bits(z) << 2;
+}
+
+namespace {
+
+struct MortonKey {
+    std::uint64_t code;
+    std::size_t index;
+
+    inline auto operator<(const MortonKey &other) const -> bool {
+        return code < other.code || (code == other.code && index < other.index);
+    }
+};
+
+}
+
+auto morton_order(const std::vector<cv::Point3f> &points, ThreadPool &pool) -> std::vector<std::size_t> {
+    const auto count = points.size();
+    if (count == 0) {
+        return {};
+    }
+
+    // Bounding box, one partial box per chunk
+    const auto grain = pool.grain(count);
+    const auto num_chunks = ThreadPool::num_chunks(count, grain);
+    std::vector<cv::Point3f> chunk_min(num_chunks), chunk_max(num_chunks);
+    pool.parallel_for(count, grain, [&] (std::size_t begin, std::size_t end) {
+        auto lo = points[begin], hi = points[begin];
+        for (auto i = begin + 1; i < end; i++) {
+            const auto &p = points[i];
+            lo = cv::Point3f(std::min(lo.x, p.x), std::min(lo.y, p.y), std::min(lo.z, p.z));
+            hi = cv::Point3f(std::max(hi.x, p.x), std::max(hi.y, p.y), std::max(hi.z, p.z));
+        }
+        chunk_min[begin / grain] = lo;
+        chunk_max[begin / grain] = hi;
+    });
+    auto lo = chunk_min[0], hi = chunk_max[0];
+    for (auto c = 1ul; c < num_chunks; c++) {
+        lo = cv::Point3f(std::min(lo.x, chunk_min[c].x), std::min(lo.y, chunk_min[c].y), std::min(lo.z, chunk_min[c].z));
+        hi = cv::Point3f(std::max(hi.x, chunk_max[c].x), std::max(hi.y, chunk_max[c].y), std::max(hi.z, chunk_max[c].z));
+    }
+
+    // One scale for all axes keeps curve cells cubic
+    const auto extent = std::max(hi.x - lo.x, std::max(hi.y - lo.y, hi.z - lo.z));
+    const auto max_cell = (float) ((1u << HOPPE_MORTON_BITS) - 1);
+    const auto scale = extent > 0.0f ? max_cell / extent : 0.0f;
+    const auto quantize = [&] (float v, float origin) {
+        return (std::uint32_t) std::min(max_cell, std::max(0.0f, (v - origin) * scale));
+    };
+
+    // Every chunk computes and sorts its own run of keys...
+    std::vector<MortonKey> keys(count), merged(count);
+    pool.parallel_for(count, grain, [&] (std::size_t begin, std::size_t end) {
+        for (auto i = begin; i < end; i++) {
+            const auto &p = points[i];
+            keys[i] = { morton_code(quantize(p.x, lo.x), quantize(p.y, lo.y), quantize(p.z, lo.z)), i };
+        }
+        std::sort(keys.begin() + begin, keys.begin() + end);
+    });
+
+    // ...then pairs of neighboring runs are merged until one run is left
+    for (auto width = grain; width < count; width *= 2) {
+        const auto num_pairs = ThreadPool::num_chunks(count, 2 * width);
+        pool.parallel_for(num_pairs, 1, [&] (std::size_t pair, std::size_t) {
+            const auto begin = pair * 2 * width;
+            const auto mid = std::min(count, begin + width);
+            const auto end = std::min(count, begin + 2 * width);
+            std::merge(keys.begin() + begin, keys.begin() + mid,
+                       keys.begin() + mid, keys.begin() + end,
+                       merged.begin() + begin);
+        });
+        keys.swap(merged);
+    }
+
+    std::vector<std::size_t> order(count);
+    pool.parallel_for(count, grain, [&] (std::size_t begin, std::size_t end) {
+        for (auto i = begin; i < end; i++) {
+            order[i] = keys[i].index;
+        }
+    });
+    return order;
+}
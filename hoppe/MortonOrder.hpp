@@ -0,0 +1,33 @@
+//
+//  MortonOrder.hpp
+//  hoppe
+//
+//  Created by apple on 16/10/2026.
+//
+
+#ifndef MortonOrder_hpp
+#define MortonOrder_hpp
+
+#include <vector>
+#include <cstdint>
+#include <opencv2/core.hpp>
+#include "ThreadPool.hpp"
+
+// Bits per axis in a Morton code, so that three of them fit in 64 bits
+#define HOPPE_MORTON_BITS 21
+
+
+/// Interleaves the low HOPPE_MORTON_BITS bits of every coordinate,
+/// x in the lowest bit.
+auto morton_code(std::uint32_t x, std::uint32_t y, std::uint32_t z) -> std::uint64_t;
+
+
+/// Orders points along a Morton (Z-order) curve over their bounding cube,
+/// so points close in space end up close in memory. Points in the same
+/// curve cell keep their relative order. Sorts in parallel on `pool`.
+/// @param points points to order
+/// @param pool threads to sort with
+/// @returns permutation: element i is the index in `points` of the i-th point along the curve
+auto morton_order(const std::vector<cv::Point3f> &points, ThreadPool &pool) -> std::vector<std::size_t>;
+
+#endif /* MortonOrder_hpp */
@@ -0,0 +1,122 @@
+//
+//  NormalSolver.cpp
+//  hoppe
+//
+//  Created by apple on 16/10/2026.
+//
+
+#include "NormalSolver.hpp"
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+// Cyclic Jacobi converges quadratically; a 3x3 float matrix settles within a few sweeps.
+#define JACOBI_SWEEPS 5
+
+constexpr auto lanes = HOPPE_NORMAL_BATCH;
+
+/// One Jacobi rotation zeroing a[p][q] of every lane. All branches are selects,
+/// so the lane loops are vectorizable.
+template<int p, int q, int r>
+static inline auto rotate(float (&a)[3][3][lanes], float (&v)[3][3][lanes]) -> void {
+    for (auto l = 0; l < lanes; l++) {
+        const auto apq = a[p][q][l];
+        const auto d = a[q][q][l] - a[p][p][l];
+        const auto root = std::sqrt(d * d + 4.0f * apq * apq);
+        // t = tan(theta), written so it stays finite when d == 0. The denominator
+        // is only zero when apq is, so nudging it leaves t = 0 without a branch.
+        const auto denominator = std::fabs(d) + root + FLT_MIN;
+        const auto t = std::copysign(1.0f, d) * 2.0f * apq / denominator;
+        const auto c = 1.0f / std::sqrt(t * t + 1.0f);
+        const auto s = t * c;
+
+        const auto app = a[p][p][l], aqq = a[q][q][l];
+        const auto arp = a[r][p][l], arq = a[r][q][l];
+        a[p][p][l] = app - t * apq;
+        a[q][q][l] = aqq + t * apq;
+        // Analytically zero; computing the residue instead of storing a constant
+        // keeps the loop free of memsets so it stays vectorized.
+        a[p][q][l] = a[q][p][l] = (c * c - s * s) * apq + c * s * (app - aqq);
+        a[r][p][l] = a[p][r][l] = c * arp - s * arq;
+        a[r][q][l] = a[q][r][l] = s * arp + c * arq;
+
+        for (auto k = 0; k < 3; k++) {
+            const auto vkp = v[k][p][l], vkq = v[k][q][l];
+            v[k][p][l] = c * vkp - s * vkq;
+            v[k][q][l] = s * vkp + c * vkq;
+        }
+    }
+}
+
+static auto solve_batch(const cv::Matx33f *covariances,
+                        std::size_t count,
+                        NormalEstimate *estimates) -> void {
+    float a[3][3][lanes], v[3][3][lanes];
+
+    // Load, normalized by trace so that tiny clouds do not underflow
+    for (auto l = 0; l < lanes; l++) {
+        const auto &m = covariances[l < count ? l : 0];
+        const auto trace = m(0, 0) + m(1, 1) + m(2, 2);
+        const auto scale = trace > 0.0f ? 1.0f / trace : 1.0f;
+        for (auto i = 0; i < 3; i++) {
+            for (auto j = i; j < 3; j++) {
+                a[i][j][l] = a[j][i][l] = m(i, j) * scale;
+            }
+            for (auto j = 0; j < 3; j++) {
+                v[i][j][l] = i == j ? 1.0f : 0.0f;
+            }
+        }
+    }
+
+    for (auto sweep = 0; sweep < JACOBI_SWEEPS; sweep++) {
+        rotate<0, 1, 2>(a, v);
+        rotate<0, 2, 1>(a, v);
+        rotate<1, 2, 0>(a, v);
+    }
+
+    // Eigenvalues are on the diagonal, eigenvectors are the columns of v
+    for (auto l = 0; l < count; l++) {
+        auto min_idx = 0;
+        for (auto i = 1; i < 3; i++) {
+            if (a[i][i][l] < a[min_idx][min_idx][l]) {
+                min_idx = i;
+            }
+        }
+        const auto sum = a[0][0][l] + a[1][1][l] + a[2][2][l];
+        estimates[l].normal = cv::normalize(cv::Vec3f(v[0][min_idx][l],
+                                                      v[1][min_idx][l],
+                                                      v[2][min_idx][l]));
+        estimates[l].curvature = sum > 0.0f ? std::max(0.0f, a[min_idx][min_idx][l]) / sum : 0.0f;
+    }
+}
+
+auto solve_normals(const cv::Matx33f *covariances,
+                   std::size_t count,
+                   NormalEstimate *estimates) -> void {
+    for (auto begin = 0ul; begin < count; begin += lanes) {
+        solve_batch(covariances + begin,
+                    std::min((std::size_t) lanes, count - begin),
+                    estimates + begin);
+    }
+}
+
+auto solve_normal_reference(const cv::Matx33f &covariance) -> NormalEstimate {
+    cv::Matx31f eigenvalues;
+    cv::Matx33f eigenvectors;
+    cv::eigen(covariance, eigenvalues, eigenvectors);
+    auto min_idx = -1;
+    auto min_val = 0.0f;
+    for (auto i = 0; i < 3; i++) {
+        if (min_idx == -1 || eigenvalues(i, 0) < min_val) {
+            min_idx = i;
+            min_val = eigenvalues(i, 0);
+        }
+    }
+    const auto sum = eigenvalues(0, 0) + eigenvalues(1, 0) + eigenvalues(2, 0);
+    NormalEstimate estimate;
+    estimate.normal = cv::normalize(cv::Vec3f(eigenvectors(min_idx, 0),
+                                              eigenvectors(min_idx, 1),
+                                              eigenvectors(min_idx, 2)));
+    estimate.curvature = sum > 0.0f ? std::max(0.0f, min_val) / sum : 0.0f;
+    return estimate;
+}
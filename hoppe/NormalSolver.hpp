@@ -0,0 +1,45 @@
+//
+//  NormalSolver.hpp
+//  hoppe
+//
+//  Created by apple on 16/10/2026.
+//
+
+#ifndef NormalSolver_hpp
+#define NormalSolver_hpp
+
+#include <opencv2/core.hpp>
+
+// 0: batched Jacobi solver, 1: cv::eigen reference solver.
+// `hoppe_bench check` compares the two.
+#ifndef HOPPE_REFERENCE_EIGEN
+#define HOPPE_REFERENCE_EIGEN 0
+#endif
+
+// Number of covariance matrices solved side by side in SIMD lanes
+#define HOPPE_NORMAL_BATCH 8
+
+
+struct NormalEstimate {
+    cv::Vec3f normal;
+
+    // Surface variation: smallest eigenvalue over the sum of eigenvalues
+    float curvature;
+};
+
+
+/// Solves symmetric 3x3 covariance matrices for the eigenvector of the smallest eigenvalue.
+/// Matrices are processed in groups of HOPPE_NORMAL_BATCH with one matrix per SIMD lane.
+/// @param covariances matrices to solve; only the upper triangle is read
+/// @param count number of matrices
+/// @param estimates output, one per matrix
+auto solve_normals(const cv::Matx33f *covariances,
+                   std::size_t count,
+                   NormalEstimate *estimates) -> void;
+
+
+/// Reference path built on cv::eigen. Slow, but used to validate solve_normals.
+/// @param covariance matrix to solve
+auto solve_normal_reference(const cv::Matx33f &covariance) -> NormalEstimate;
+
+#endif /* NormalSolver_hpp */
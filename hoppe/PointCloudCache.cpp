@@ -0,0 +1,243 @@
+//
+//  PointCloudCache.cpp
+//  hoppe
+//
+//  Created by apple on 16/10/2026.
+//
+
+#include "PointCloudCache.hpp"
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <stdexcept>
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <sys/stat.h>
+
+static constexpr char magic[8] = { 'H', 'O', 'P', 'P', 'E', 'P', 'C', '\0' };
+static constexpr long section_alignment = 64;
+
+// Sections are copied as raw arrays
+static_assert(sizeof(cv::Point3f) == 3 * sizeof(float), "Point3f must be packed");
+static_assert(sizeof(Plane) == 6 * sizeof(float), "Plane must be packed");
+
+/// Pads `file` with zeros up to the next section boundary.
+/// @returns offset of the next section
+static auto align_section(FILE *file) -> std::uint64_t {
+    auto offset = std::ftell(file);
+    while (offset % section_alignment != 0) {
+        std::fputc(0, file);
+        offset++;
+    }
+    return (std::uint64_t) offset;
+}
+
+/// Saves a tree at the next section boundary.
+template<typename Index>
+static auto write_index(FILE *file, Index *index, std::uint64_t &offset, std::uint64_t &size) -> void {
+    offset = align_section(file);
+    if (index != nullptr) {
+        index->saveIndex(file);
+    }
+    size = (std::uint64_t) std::ftell(file) - offset;
+}
+
+/// Loads a tree over `dataset` from its section of `file`.
+/// @returns null if the section is empty, truncated or over another cloud
+template<typename Index, typename Dataset>
+static auto read_index(FILE *file,
+                       std::uint64_t offset,
+                       std::uint64_t size,
+                       const Dataset &dataset) -> std::unique_ptr<Index> {
+    if (size == 0) {
+        return nullptr;
+    }
+    auto index = std::make_unique<Index>(3, dataset);
+
+    // loadIndex sizes the index array by a count read from the file, so check
+    // it first: the tree must index every point of `dataset`, or it would hand
+    // out foreign indices, and the array must fit in the section.
+    const auto count_offset = sizeof(index->m_size) + sizeof(index->dim) +
+        sizeof(index->root_bbox) + sizeof(index->m_leaf_max_size);
+    std::size_t count = 0;
+    if (size < count_offset + sizeof(std::size_t) ||
+        std::fseek(file, (long) (offset + count_offset), SEEK_SET) != 0 ||
+        std::fread(&count, sizeof(count), 1, file) != 1) {
+        return nullptr;
+    }
+    if (count != dataset.kdtree_get_point_count() ||
+        count > (size - count_offset - sizeof(std::size_t)) / sizeof(index->vind[0])) {
+        return nullptr;
+    }
+
+    if (std::fseek(file, (long) offset, SEEK_SET) != 0) {
+        return nullptr;
+    }
+    try {
+        index->loadIndex(file);
+    } catch (const std::exception &) {
+        return nullptr;
+    }
+    // Nodes are read until the tree is complete, which must not run past the section
+    if ((std::uint64_t) std::ftell(file) > offset + size) {
+        return nullptr;
+    }
+    return index;
+}
+
+auto CacheSource::of(const std::string &path) -> CacheSource {
+    CacheSource source;
+    char resolved[PATH_MAX];
+    struct stat file_stat;
+    if (realpath(path.c_str(), resolved) == nullptr || stat(resolved, &file_stat) != 0) {
+        return source;
+    }
+    source.path = resolved;
+    source.size = (std::uint64_t) file_stat.st_size;
+    source.mtime = (std::int64_t) file_stat.st_mtime;
+    return source;
+}
+
+auto PointCloudCache::write(const std::string &path,
+                            const PointCloud &pointcloud,
+                            const Planes &planes,
+                            const PlaneSettings &settings,
+                            const CacheSource &source,
+                            PointCloudIndex *point_index,
+                            PlaneCloudIndex *plane_index) -> bool {
+    auto file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        HOPPE_LOG("WARNING! Bad writer: %s", path.c_str());
+        return false;
+    }
+
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.k = planes.planes.empty() ? 0 : settings.k;
+    header.mst_algorithm = (std::uint8_t) settings.mst_algorithm;
+    header.shared_knn = settings.shared_knn ? 1 : 0;
+    header.spatial_order = settings.spatial_order ? 1 : 0;
+    header.source_size = source.size;
+    header.source_mtime = source.mtime;
+    if (source.path.size() < sizeof(header.source_path)) {
+        std::memcpy(header.source_path, source.path.c_str(), source.path.size() + 1);
+    }
+    header.num_points = pointcloud.points.size();
+    header.num_planes = planes.planes.size();
+    std::fwrite(&header, sizeof(header), 1, file);
+
+    header.points_offset = align_section(file);
+    std::fwrite(pointcloud.points.data(), sizeof(cv::Point3f), pointcloud.points.size(), file);
+    header.planes_offset = align_section(file);
+    std::fwrite(planes.planes.data(), sizeof(Plane), planes.planes.size(), file);
+    write_index(file, point_index, header.point_index_offset, header.point_index_size);
+    write_index(file, plane_index, header.plane_index_offset, header.plane_index_size);
+    const auto file_size = std::ftell(file);
+
+    // Offsets are only known now
+    std::fseek(file, 0, SEEK_SET);
+    std::fwrite(&header, sizeof(header), 1, file);
+    const auto failed = std::ferror(file) != 0;
+    if (std::fclose(file) != 0 || failed) {
+        HOPPE_LOG("WARNING! Failed writing %s", path.c_str());
+        return false;
+    }
+    HOPPE_LOG("Cache written to %s. %.2f MB", path.c_str(), file_size / 1048576.0);
+    return true;
+}
+
+auto PointCloudCache::read(const std::string &path,
+                           PointCloud &pointcloud,
+                           Planes &planes,
+                           PlaneSettings &settings,
+                           CacheSource &source,
+                           std::unique_ptr<PointCloudIndex> &point_index,
+                           std::unique_ptr<PlaneCloudIndex> &plane_index) -> bool {
+    const auto load_begin = std::chrono::steady_clock::now();
+    point_index.reset();
+    plane_index.reset();
+    pointcloud.points.clear();
+    planes.planes.clear();
+    settings = PlaneSettings();
+    source = CacheSource();
+
+    auto file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    std::fseek(file, 0, SEEK_END);
+    const auto file_size = (std::uint64_t) std::max(0l, std::ftell(file));
+    std::fseek(file, 0, SEEK_SET);
+
+    Header header;
+    if (file_size < sizeof(Header) || std::fread(&header, sizeof(header), 1, file) != 1) {
+        HOPPE_LOG("WARNING! Empty or unreadable cache: %s", path.c_str());
+        std::fclose(file);
+        return false;
+    }
+    const auto fits = [&] (std::uint64_t offset, std::uint64_t size) {
+        return offset <= file_size && size <= file_size - offset;
+    };
+    if (std::memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != version) {
+        HOPPE_LOG("WARNING! Not a version %u cache: %s", version, path.c_str());
+        std::fclose(file);
+        return false;
+    }
+    if (header.num_points > file_size / sizeof(cv::Point3f) ||
+        header.num_planes > file_size / sizeof(Plane) ||
+        !fits(header.points_offset, header.num_points * sizeof(cv::Point3f)) ||
+        !fits(header.planes_offset, header.num_planes * sizeof(Plane)) ||
+        !fits(header.point_index_offset, header.point_index_size) ||
+        !fits(header.plane_index_offset, header.plane_index_size)) {
+        HOPPE_LOG("WARNING! Truncated cache: %s", path.c_str());
+        std::fclose(file);
+        return false;
+    }
+
+    pointcloud.points.resize(header.num_points);
+    planes.planes.resize(header.num_planes);
+    auto ok = std::fseek(file, (long) header.points_offset, SEEK_SET) == 0 &&
+        std::fread(pointcloud.points.data(), sizeof(cv::Point3f), header.num_points, file) == header.num_points &&
+        std::fseek(file, (long) header.planes_offset, SEEK_SET) == 0 &&
+        std::fread(planes.planes.data(), sizeof(Plane), header.num_planes, file) == header.num_planes;
+    if (ok) {
+        point_index = read_index<PointCloudIndex>(file,
+                                                  header.point_index_offset,
+                                                  header.point_index_size,
+                                                  pointcloud);
+        plane_index = read_index<PlaneCloudIndex>(file,
+                                                  header.plane_index_offset,
+                                                  header.plane_index_size,
+                                                  planes);
+        ok = (header.point_index_size == 0 || point_index) && (header.plane_index_size == 0 || plane_index);
+    }
+    std::fclose(file);
+
+    if (!ok) {
+        HOPPE_LOG("WARNING! Corrupt cache: %s", path.c_str());
+        point_index.reset();
+        plane_index.reset();
+        pointcloud.points.clear();
+        planes.planes.clear();
+        return false;
+    }
+    settings.k = header.k;
+    settings.mst_algorithm = (MSTAlgorithm) header.mst_algorithm;
+    settings.shared_knn = header.shared_knn != 0;
+    settings.spatial_order = header.spatial_order != 0;
+    header.source_path[sizeof(header.source_path) - 1] = '\0';
+    source.path = header.source_path;
+    source.size = header.source_size;
+    source.mtime = header.source_mtime;
+
+    const std::chrono::duration<double> load_time = std::chrono::steady_clock::now() - load_begin;
+    HOPPE_LOG("Cache loaded from %s. Points: %lu, planes: %lu, %.2f ms",
+              path.c_str(),
+              pointcloud.points.size(),
+              planes.planes.size(),
+              load_time.count() * 1000.0);
+    return true;
+}
@@ -0,0 +1,104 @@
+//
+//  PointCloudCache.hpp
+//  hoppe
+//
+//  Created by apple on 16/10/2026.
+//
+
+#ifndef PointCloudCache_hpp
+#define PointCloudCache_hpp
+
+#include <string>
+#include <memory>
+#include <cstdint>
+#include "hoppe_common.hpp"
+
+/// Input file a cache was built from, to tell when the cache went stale.
+struct CacheSource {
+    // Absolute path, empty for clouds that did not come from a file
+    std::string path;
+    std::uint64_t size = 0;
+    // Last modification, in seconds since the epoch
+    std::int64_t mtime = 0;
+
+    /// Describes the file at `path` as it is now.
+    /// @returns an empty source if the file cannot be read
+    static auto of(const std::string &path) -> CacheSource;
+
+    auto operator==(const CacheSource &other) const -> bool {
+        return path == other.path && size == other.size && mtime == other.mtime;
+    }
+};
+
+/// Binary container holding a point cloud, its oriented tangent planes and
+/// both kd-trees, so a cloud can be re-meshed without parsing, plane
+/// estimation, orientation or tree construction. The header records the
+/// file the cloud came from and the settings the planes were computed with,
+/// so stale caches can be told apart.
+///
+/// Layout: a fixed header, then the points and the planes as raw arrays,
+/// then the trees as written by nanoflann's `saveIndex`. Every section
+/// starts on a 64 byte boundary. Sections are read with plain file reads
+/// into the usual containers.
+class PointCloudCache {
+public:
+    static constexpr std::uint32_t version = 2;
+
+    struct Header {
+        char magic[8];
+        std::uint32_t version;
+        // Settings of the planes; k is 0 without planes
+        std::int32_t k;
+        std::uint8_t mst_algorithm;
+        std::uint8_t shared_knn;
+        std::uint8_t spatial_order;
+        std::uint8_t padding[5];
+        std::uint64_t num_points;
+        std::uint64_t num_planes;
+        std::uint64_t points_offset;
+        std::uint64_t planes_offset;
+        std::uint64_t point_index_offset, point_index_size;
+        std::uint64_t plane_index_offset, plane_index_size;
+        std::uint64_t source_size;
+        std::int64_t source_mtime;
+        // Zero terminated; empty if the path did not fit
+        char source_path[1024];
+    };
+
+    /// Writes a cache. Missing trees are left out.
+    /// @param path file to write
+    /// @param pointcloud points
+    /// @param planes oriented tangent planes, may be empty
+    /// @param settings settings the planes were computed with
+    /// @param source file the points came from
+    /// @param point_index tree over `pointcloud`, may be null
+    /// @param plane_index tree over `planes`, may be null
+    /// @returns true if the whole cache was written
+    static auto write(const std::string &path,
+                      const PointCloud &pointcloud,
+                      const Planes &planes,
+                      const PlaneSettings &settings,
+                      const CacheSource &source,
+                      PointCloudIndex *point_index,
+                      PlaneCloudIndex *plane_index) -> bool;
+
+    /// Reads a cache. The trees index `pointcloud` and `planes`, which must
+    /// outlive them, and are null when the cache has none.
+    /// @param path file to read
+    /// @param pointcloud receives the points
+    /// @param planes receives the planes
+    /// @param settings receives the settings of the planes
+    /// @param source receives the file the points came from
+    /// @param point_index receives the point tree
+    /// @param plane_index receives the plane tree
+    /// @returns false if the file is missing, truncated or of another version
+    static auto read(const std::string &path,
+                     PointCloud &pointcloud,
+                     Planes &planes,
+                     PlaneSettings &settings,
+                     CacheSource &source,
+                     std::unique_ptr<PointCloudIndex> &point_index,
+                     std::unique_ptr<PlaneCloudIndex> &plane_index) -> bool;
+};
+
+#endif /* PointCloudCache_hpp */
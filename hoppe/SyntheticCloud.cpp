@@ -0,0 +1,216 @@
+//
+//  SyntheticCloud.cpp
+//  hoppe
+//
+//  Created by apple on 16/10/2026.
+//
+
+#include "SyntheticCloud.hpp"
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <charconv>
+#include <limits>
+#include <algorithm>
+#include "hoppe_common.hpp"
+
+// Every block draws from its own generator, so the cloud does not depend
+// on how blocks are spread over threads
+#define SYNTHETIC_BLOCK_SIZE (1 << 16)
+
+static constexpr auto pi = 3.14159265358979f;
+static constexpr auto torus_minor = 0.4f;
+static const cv::Vec3f box_half(1.0f, 0.7f, 0.4f);
+
+/// Area of the unit sized shape.
+static auto unit_area(SyntheticShape shape) -> float {
+    switch (shape) {
+        case SyntheticShape::sphere:
+            return 4.0f * pi;
+        case SyntheticShape::torus:
+            return 4.0f * pi * pi * torus_minor;
+        case SyntheticShape::box:
+            return 8.0f * (box_half(0) * box_half(1) + box_half(1) * box_half(2) + box_half(0) * box_half(2));
+        default:
+            return 4.0f;
+    }
+}
+
+/// Uniform sample of the unit sized shape.
+static auto sample_unit(SyntheticShape shape, std::mt19937 &rng) -> cv::Point3f {
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    switch (shape) {
+        case SyntheticShape::sphere: {
+            // Archimedes: z is uniform on a sphere
+            const auto z = 2.0f * uniform(rng) - 1.0f;
+            const auto phi = 2.0f * pi * uniform(rng);
+            const auto r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+            return cv::Point3f(r * std::cos(phi), r * std::sin(phi), z);
+        }
+        case SyntheticShape::torus: {
+            // The outer side of the tube has more area; reject to match
+            auto v = 0.0f;
+            do {
+                v = 2.0f * pi * uniform(rng);
+            } while (uniform(rng) * (1.0f + torus_minor) > 1.0f + torus_minor * std::cos(v));
+            const auto u = 2.0f * pi * uniform(rng);
+            const auto ring = 1.0f + torus_minor * std::cos(v);
+            return cv::Point3f(ring * std::cos(u), ring * std::sin(u), torus_minor * std::sin(v));
+        }
+        case SyntheticShape::box: {
+            // Pick a face by area, then a point on it
+            const float face_area[3] = {
+                box_half(1) * box_half(2),
+                box_half(0) * box_half(2),
+                box_half(0) * box_half(1)
+            };
+            auto pick = uniform(rng) * (face_area[0] + face_area[1] + face_area[2]);
+            auto axis = 0;
+            while (axis < 2 && pick >= face_area[axis]) {
+                pick -= face_area[axis];
+                axis++;
+            }
+            cv::Vec3f p;
+            for (auto i = 0; i < 3; i++) {
+                p(i) = (2.0f * uniform(rng) - 1.0f) * box_half(i);
+            }
+            p(axis) = uniform(rng) < 0.5f ? -box_half(axis) : box_half(axis);
+            return VEC2POINT(p);
+        }
+        default:
+            return cv::Point3f(2.0f * uniform(rng) - 1.0f, 2.0f * uniform(rng) - 1.0f, 0.0f);
+    }
+}
+
+/// Signed distance to the unit sized shape.
+static auto sdf_unit(SyntheticShape shape, cv::Point3f p) -> float {
+    switch (shape) {
+        case SyntheticShape::sphere:
+            return std::sqrt(p.dot(p)) - 1.0f;
+        case SyntheticShape::torus: {
+            const auto ring = std::sqrt(p.x * p.x + p.y * p.y) - 1.0f;
+            return std::sqrt(ring * ring + p.z * p.z) - torus_minor;
+        }
+        case SyntheticShape::box: {
+            const cv::Vec3f q(std::fabs(p.x) - box_half(0), std::fabs(p.y) - box_half(1), std::fabs(p.z) - box_half(2));
+            const cv::Vec3f outside(std::max(q(0), 0.0f), std::max(q(1), 0.0f), std::max(q(2), 0.0f));
+            return (float) cv::norm(outside) + std::min(std::max(q(0), std::max(q(1), q(2))), 0.0f);
+        }
+        default: {
+            // Distance to the nearest point of the square, not of z = 0
+            const cv::Point3f nearest(std::clamp(p.x, -1.0f, 1.0f), std::clamp(p.y, -1.0f, 1.0f), 0.0f);
+            return std::copysign((float) cv::norm(p - nearest), p.z);
+        }
+    }
+}
+
+SyntheticCloud::SyntheticCloud(SyntheticShape shape, float noise, unsigned int seed) : noise(noise), seed(seed) {
+    if (shape == SyntheticShape::scene) {
+        add_component(SyntheticShape::sphere, cv::Point3f(-2.5f, 0.0f, 0.0f), 0.8f);
+        add_component(SyntheticShape::torus, cv::Point3f(0.0f, 0.0f, 0.0f), 1.0f);
+        add_component(SyntheticShape::box, cv::Point3f(2.5f, 0.0f, 0.0f), 0.8f);
+    } else {
+        add_component(shape, cv::Point3f(0.0f, 0.0f, 0.0f), 1.0f);
+    }
+}
+
+auto SyntheticCloud::add_component(SyntheticShape shape, cv::Point3f center, float scale) -> void {
+    const auto area = unit_area(shape) * scale * scale;
+    components.push_back({ shape, center, scale, area });
+    cumulative_area.push_back((cumulative_area.empty() ? 0.0f : cumulative_area.back()) + area);
+}
+
+auto SyntheticCloud::sample(std::size_t count, ThreadPool &pool) const -> std::vector<cv::Point3f> {
+    std::vector<cv::Point3f> points(count);
+    const auto num_blocks = (count + SYNTHETIC_BLOCK_SIZE - 1) / SYNTHETIC_BLOCK_SIZE;
+    pool.parallel_for(num_blocks, 1, [&] (std::size_t block, std::size_t) {
+        std::seed_seq seeds { seed, (unsigned int) block, (unsigned int) (block >> 32) };
+        std::mt19937 rng(seeds);
+        std::uniform_real_distribution<float> uniform(0.0f, cumulative_area.back());
+        std::normal_distribution<float> gaussian(0.0f, noise > 0.0f ? noise : 1.0f);
+        const auto begin = block * SYNTHETIC_BLOCK_SIZE;
+        const auto end = std::min(count, begin + SYNTHETIC_BLOCK_SIZE);
+        for (auto i = begin; i < end; i++) {
+            const auto pick = uniform(rng);
+            const auto c = std::min((std::size_t) (std::upper_bound(cumulative_area.begin(),
+                                                                    cumulative_area.end(),
+                                                                    pick) - cumulative_area.begin()),
+                                    components.size() - 1);
+            const auto &component = components[c];
+            auto p = component.center + sample_unit(component.shape, rng) * component.scale;
+            if (noise > 0.0f) {
+                p += cv::Point3f(gaussian(rng), gaussian(rng), gaussian(rng));
+            }
+            points[i] = p;
+        }
+    });
+    return points;
+}
+
+auto SyntheticCloud::sdf(cv::Point3f point) const -> float {
+    // Components do not overlap, so the union is exact
+    auto distance = std::numeric_limits<float>::max();
+    for (const auto &component : components) {
+        const auto local = (point - component.center) * (1.0f / component.scale);
+        distance = std::min(distance, sdf_unit(component.shape, local) * component.scale);
+    }
+    return distance;
+}
+
+auto SyntheticCloud::name(SyntheticShape shape) -> const char * {
+    switch (shape) {
+        case SyntheticShape::sphere:
+            return "sphere";
+        case SyntheticShape::torus:
+            return "torus";
+        case SyntheticShape::box:
+            return "box";
+        case SyntheticShape::plane:
+            return "plane";
+        default:
+            return "scene";
+    }
+}
+
+auto SyntheticCloud::write_xyz(const std::string &path,
+                               const std::vector<cv::Point3f> &points,
+                               ThreadPool &pool) -> bool {
+    auto file = std::fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        HOPPE_LOG("WARNING! Bad writer: %s", path.c_str());
+        return false;
+    }
+    // Chunks format consecutive ranges into their own buffers, which are
+    // written in order; rounds keep the buffers bounded for huge clouds
+    const auto num_buffers = (std::size_t) pool.size();
+    const auto points_per_buffer = 1ul << 18;
+    // Three shortest round-trip floats, two blanks and a newline
+    const auto max_line = 3 * 16 + 3;
+    std::vector<std::vector<char> > buffers(num_buffers, std::vector<char>(points_per_buffer * max_line));
+    std::vector<std::size_t> sizes(num_buffers, 0);
+    for (auto round = 0ul; round < points.size(); round += num_buffers * points_per_buffer) {
+        const auto round_points = std::min(points.size() - round, num_buffers * points_per_buffer);
+        pool.parallel_for(round_points, points_per_buffer, [&] (std::size_t begin, std::size_t end) {
+            const auto t = begin / points_per_buffer;
+            auto *out = buffers[t].data();
+            for (auto i = round + begin; i < round + end; i++) {
+                const float values[3] = { points[i].x, points[i].y, points[i].z };
+                for (auto j = 0; j < 3; j++) {
+                    out = std::to_chars(out, out + 16, values[j]).ptr;
+                    *out++ = j < 2 ? ' ' : '\n';
+                }
+            }
+            sizes[t] = out - buffers[t].data();
+        });
+        const auto round_buffers = ThreadPool::num_chunks(round_points, points_per_buffer);
+        for (auto t = 0ul; t < round_buffers; t++) {
+            std::fwrite(buffers[t].data(), 1, sizes[t], file);
+        }
+    }
+    const auto failed = std::ferror(file) != 0;
+    if (std::fclose(file) != 0 || failed) {
+        HOPPE_LOG("WARNING! Failed writing %s", path.c_str());
+        return false;
+    }
+    return true;
+}
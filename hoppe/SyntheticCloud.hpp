@@ -0,0 +1,71 @@
+//
+//  SyntheticCloud.hpp
+//  hoppe
+//
+//  Created by apple on 16/10/2026.
+//
+
+#ifndef SyntheticCloud_hpp
+#define SyntheticCloud_hpp
+
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+#include "ThreadPool.hpp"
+
+enum class SyntheticShape {
+    sphere,     // radius 1
+    torus,      // radii 1 and 0.4 around the z axis
+    box,        // half extents 1, 0.7 and 0.4
+    plane,      // open 2 x 2 square in z = 0
+    scene       // sphere, torus and box side by side along x
+};
+
+/// Point clouds sampled from analytic surfaces, along with their exact
+/// signed distance function, to measure throughput and accuracy at sizes
+/// the bundled assets do not reach.
+class SyntheticCloud {
+public:
+    /// @param shape surface to sample
+    /// @param noise standard deviation of the Gaussian noise added to every coordinate
+    /// @param seed random seed; the same seed yields the same cloud for any thread count
+    SyntheticCloud(SyntheticShape shape, float noise = 0.0f, unsigned int seed = 42);
+
+    /// Samples `count` points uniformly by area, in parallel.
+    /// @param count number of points
+    /// @param pool pool sampling blocks of points
+    auto sample(std::size_t count, ThreadPool &pool) const -> std::vector<cv::Point3f>;
+
+    /// Signed distance from `point` to the noise-free surface, negative inside.
+    /// The plane has no inside, so its distance to the square is signed by z.
+    auto sdf(cv::Point3f point) const -> float;
+
+    static auto name(SyntheticShape shape) -> const char *;
+
+    /// Writes `points` as "x y z" lines, the format `Hoppe::load_pointcloud` reads.
+    /// @param path file to write
+    /// @param points points to write
+    /// @param pool pool formatting ranges of points
+    /// @returns true if every point was written
+    static auto write_xyz(const std::string &path,
+                          const std::vector<cv::Point3f> &points,
+                          ThreadPool &pool) -> bool;
+
+private:
+    struct Component {
+        SyntheticShape shape;
+        cv::Point3f center;
+        float scale;
+        float area;
+    };
+
+    auto add_component(SyntheticShape shape, cv::Point3f center, float scale) -> void;
+
+    std::vector<Component> components;
+    // Running sum of component areas, to pick components by area
+    std::vector<float> cumulative_area;
+    float noise;
+    unsigned int seed;
+};
+
+#endif /* SyntheticCloud_hpp */
@@ -0,0 +1,165 @@
+//
+//  ThreadPool.cpp
+//  hoppe
+//
+//  Created by apple on 16/10/2026.
+//
+
+#include "ThreadPool.hpp"
+#include <algorithm>
+
+// Pool and queue of the worker running on this thread, if any
+static thread_local const ThreadPool *current_pool = nullptr;
+static thread_local unsigned int current_slot_index = 0;
+
+ThreadPool::ThreadPool(unsigned int num_threads) {
+    if (num_threads == 0) {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (auto slot = 0u; slot < num_threads; slot++) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    // Slot 0 belongs to whoever calls parallel_for from outside
+    for (auto slot = 1u; slot < num_threads; slot++) {
+        workers.push_back(std::thread(&ThreadPool::worker_loop, this, slot));
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        stopping = true;
+    }
+    work_ready.notify_all();
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+auto ThreadPool::grain(std::size_t count, std::size_t chunks_per_thread) const -> std::size_t {
+    const auto num_chunks = std::max((std::size_t) 1, size() * chunks_per_thread);
+    return std::max((std::size_t) 1, (count + num_chunks - 1) / num_chunks);
+}
+
+auto ThreadPool::current_slot() const -> unsigned int {
+    return current_pool == this ? current_slot_index : 0;
+}
+
+auto ThreadPool::push(unsigned int slot, Task task) -> void {
+    {
+        std::lock_guard<std::mutex> lock(queues[slot]->mutex);
+        queues[slot]->tasks.push_back(task);
+    }
+    queued++;
+    // A worker going to sleep counts itself before it checks `queued`, so
+    // either it sees this task or it is counted here
+    if (sleeping.load() > 0) {
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+        }
+        work_ready.notify_one();
+    }
+}
+
+auto ThreadPool::take(unsigned int slot, Task &task) -> bool {
+    if (queued.load() == 0) {
+        return false;
+    }
+    // Newest own task first: it continues where the last one stopped
+    {
+        auto &queue = *queues[slot];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = queue.tasks.back();
+            queue.tasks.pop_back();
+            queued--;
+            return true;
+        }
+    }
+    // Oldest task of another thread: the largest piece it left
+    for (auto i = 1u; i < size(); i++) {
+        auto &queue = *queues[(slot + i) % size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+            queued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+auto ThreadPool::run(unsigned int slot, Task task) -> void {
+    auto &job = *task.job;
+    // Keep the lower half and offer the upper one until a single chunk is
+    // left; halves are cut at chunk boundaries
+    while (task.end - task.begin > job.grain) {
+        const auto mid = task.begin + num_chunks(task.end - task.begin, job.grain) / 2 * job.grain;
+        push(slot, { task.job, mid, task.end });
+        task.end = mid;
+    }
+    (*job.func)(task.begin, task.end);
+
+    const auto count = task.end - task.begin;
+    if (job.remaining.fetch_sub(count) == count) {
+        std::lock_guard<std::mutex> lock(job.mutex);
+        job.finished = true;
+        job.done.notify_all();
+    }
+}
+
+auto ThreadPool::worker_loop(unsigned int slot) -> void {
+    current_pool = this;
+    current_slot_index = slot;
+    Task task;
+    while (true) {
+        if (take(slot, task)) {
+            run(slot, task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        sleeping++;
+        work_ready.wait(lock, [&] {
+            return stopping || queued.load() > 0;
+        });
+        sleeping--;
+        if (stopping && queued.load() == 0) {
+            return;
+        }
+    }
+}
+
+auto ThreadPool::parallel_for(std::size_t count,
+                              std::size_t grain,
+                              const std::function<void(std::size_t, std::size_t)> &func) -> void {
+    if (count == 0) {
+        return;
+    }
+    Job job;
+    job.func = &func;
+    job.grain = std::max((std::size_t) 1, grain);
+    job.remaining = count;
+
+    // One contiguous share per thread, the first one for the caller
+    const auto slot = current_slot();
+    const auto chunks = num_chunks(count, job.grain);
+    const auto chunks_per_share = (chunks + size() - 1) / size();
+    const auto shares = num_chunks(chunks, chunks_per_share);
+    const auto share_size = chunks_per_share * job.grain;
+    for (auto share = shares; share-- > 0;) {
+        const auto begin = share * share_size;
+        push((unsigned int) ((slot + share) % size()), { &job, begin, std::min(count, begin + share_size) });
+    }
+
+    // Work while there is anything to take, then sleep until the threads
+    // still running the last chunks are done
+    Task task;
+    while (job.remaining.load() != 0 && take(slot, task)) {
+        run(slot, task);
+    }
+    std::unique_lock<std::mutex> lock(job.mutex);
+    job.done.wait(lock, [&] {
+        return job.finished;
+    });
+}
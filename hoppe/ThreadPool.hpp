@@ -0,0 +1,106 @@
+//
+//  ThreadPool.hpp
+//  hoppe
+//
+//  Created by apple on 16/10/2026.
+//
+
+#ifndef ThreadPool_hpp
+#define ThreadPool_hpp
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+/// Work-stealing pool shared by every parallel stage.
+///
+/// `parallel_for` hands every thread a contiguous share of the range. A
+/// thread splits its share in halves as it goes, keeping the half it works
+/// on and queueing the other, so idle threads can steal the largest pending
+/// pieces from busy ones. Empty regions finish early and their threads move
+/// on to the dense ones instead of waiting.
+class ThreadPool {
+public:
+    /// @param num_threads threads running tasks, including the one calling
+    ///     `parallel_for`; 0 for one per hardware thread
+    explicit ThreadPool(unsigned int num_threads = 0);
+
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    auto operator=(const ThreadPool &) -> ThreadPool & = delete;
+
+    /// Number of threads running tasks, including the caller.
+    auto size() const -> unsigned int {
+        return (unsigned int) queues.size();
+    }
+
+    /// Grain that cuts `count` items into a few chunks per thread, for loops
+    /// whose chunks have a fixed cost on top of their items.
+    auto grain(std::size_t count, std::size_t chunks_per_thread = 4) const -> std::size_t;
+
+    /// Number of chunks `parallel_for` cuts `count` items into.
+    static auto num_chunks(std::size_t count, std::size_t grain) -> std::size_t {
+        return (count + grain - 1) / grain;
+    }
+
+    /// Calls `func(begin, end)` for chunks of [0, count) and returns when all
+    /// of them are done. Chunk c is [c * grain, min(count, (c + 1) * grain)),
+    /// so `begin / grain` can index per-chunk results. The calling thread
+    /// works too, and may call `parallel_for` again from inside `func`.
+    /// @param count number of items
+    /// @param grain items per chunk
+    /// @param func called once per chunk, from any thread
+    auto parallel_for(std::size_t count,
+                      std::size_t grain,
+                      const std::function<void(std::size_t, std::size_t)> &func) -> void;
+
+private:
+    struct Job {
+        const std::function<void(std::size_t, std::size_t)> *func;
+        std::size_t grain;
+        std::atomic<std::size_t> remaining;
+        // `finished` is only touched under `mutex`, so the caller cannot
+        // return while the last thread still signals it
+        std::mutex mutex;
+        std::condition_variable done;
+        bool finished = false;
+    };
+
+    struct Task {
+        Job *job;
+        std::size_t begin, end;
+    };
+
+    struct alignas(64) Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    auto push(unsigned int slot, Task task) -> void;
+
+    auto take(unsigned int slot, Task &task) -> bool;
+
+    auto run(unsigned int slot, Task task) -> void;
+
+    auto worker_loop(unsigned int slot) -> void;
+
+    /// Queue of the calling thread; threads from outside share slot 0.
+    auto current_slot() const -> unsigned int;
+
+    std::vector<std::unique_ptr<Queue> > queues;
+    std::vector<std::thread> workers;
+
+    std::atomic<std::size_t> queued { 0 };
+    std::atomic<unsigned int> sleeping { 0 };
+    std::mutex sleep_mutex;
+    std::condition_variable work_ready;
+    bool stopping = false;
+};
+
+#endif /* ThreadPool_hpp */
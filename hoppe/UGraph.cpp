@@ -7,6 +7,13 @@
 
 #include "UGraph.hpp"
 #include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <memory>
 
 
 auto find_root(std::vector<Subset> &subsets, int i) -> int {
@@ -50,7 +57,18 @@ auto UGraph::clean_duplicate_edges() -> void {
     edges.erase(last, edges.end());
 }
 
-auto UGraph::generate_mst() -> UGraph { 
+auto UGraph::generate_mst(MSTAlgorithm algorithm, ThreadPool *pool) -> UGraph {
+    switch (algorithm) {
+        case MSTAlgorithm::boruvka:
+            return generate_mst_boruvka(pool);
+
+        case MSTAlgorithm::kruskal:
+        default:
+            return generate_mst_kruskal();
+    }
+}
+
+auto UGraph::generate_mst_kruskal() -> UGraph {
     UGraph mst(num_nodes);
     
     std::sort(edges.begin(), edges.end(), [] (const auto &e1, const auto &e2) {
@@ -58,7 +76,8 @@ auto UGraph::generate_mst() -> UGraph {
     });
     
     std::vector<Subset> subsets;
-    for (auto i = 0; i < edges.size(); i++) {
+    subsets.reserve(num_nodes);
+    for (auto i = 0; i < num_nodes; i++) {
         subsets.push_back(Subset(i));
     }
     
@@ -80,27 +99,191 @@ auto UGraph::generate_mst() -> UGraph {
     return mst;
 }
 
-auto UGraph::traverse_dfs(int begin, std::function<void (int)> func) const -> void {
-    std::vector<std::size_t> queue, explored;
-    queue.push_back(begin);
-    
-    while (!queue.empty()) {
-        const auto p = queue[0];
-        queue.erase(queue.begin(), queue.begin() + 1);
-        if (std::find(explored.begin(), explored.end(), p) != explored.end()) {
-            continue;
+/// Lock-free find with path halving.
+static auto find_root_atomic(std::vector<std::atomic<std::size_t> > &parents, std::size_t i) -> std::size_t {
+    while (true) {
+        auto parent = parents[i].load(std::memory_order_relaxed);
+        if (parent == i) {
+            return i;
+        }
+        const auto grandparent = parents[parent].load(std::memory_order_relaxed);
+        if (grandparent != parent) {
+            // Another thread may have moved it meanwhile; losing the race is harmless
+            parents[i].compare_exchange_weak(parent, grandparent, std::memory_order_relaxed);
+        }
+        i = grandparent;
+    }
+}
+
+/// Lock-free union. The larger root is always linked under the smaller one,
+/// so concurrent unions can never form a cycle.
+/// @returns false if a and b were already in the same set
+static auto set_union_atomic(std::vector<std::atomic<std::size_t> > &parents, std::size_t a, std::size_t b) -> bool {
+    while (true) {
+        auto a_root = find_root_atomic(parents, a),
+            b_root = find_root_atomic(parents, b);
+        if (a_root == b_root) {
+            return false;
+        }
+        if (a_root > b_root) {
+            std::swap(a_root, b_root);
+        }
+        auto expected = b_root;
+        if (parents[b_root].compare_exchange_strong(expected, a_root)) {
+            return true;
         }
-        explored.push_back(p);
-        func((int) p);
-        // Neighbor iterator
-        const auto loc_func = [p] (const auto &edge) {
-            return edge.a == p || edge.b == p;
-        };
-        auto nb_it = std::find_if(edges.begin(), edges.end(), loc_func);
-        while (nb_it != edges.end()) {
-            queue.push_back(nb_it->a == p ? nb_it->b : nb_it->a);
-            nb_it = std::find_if(nb_it + 1, edges.end(), loc_func);
+    }
+}
+
+/// Packs an edge into a key that orders by cost first, then by edge index,
+/// so that every edge weight is distinct and Boruvka cannot pick a cycle.
+static auto edge_key(float cost, std::uint32_t index) -> std::uint64_t {
+    std::uint32_t bits;
+    std::memcpy(&bits, &cost, sizeof(bits));
+    // Map IEEE floats to unsigned integers with the same ordering
+    bits = (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+    return ((std::uint64_t) bits << 32) | index;
+}
+
+auto UGraph::generate_mst_boruvka(ThreadPool *pool) -> UGraph {
+    if (edges.size() >= std::numeric_limits<std::uint32_t>::max()) {
+        // Edge indices would not fit in the packed keys
+        return generate_mst_kruskal();
+    }
+    UGraph mst(num_nodes);
+    if (num_nodes == 0) {
+        return mst;
+    }
+
+    std::unique_ptr<ThreadPool> own_pool;
+    if (pool == nullptr) {
+        own_pool = std::make_unique<ThreadPool>();
+        pool = own_pool.get();
+    }
+    std::vector<std::atomic<std::size_t> > parents(num_nodes);
+    std::vector<std::atomic<std::uint64_t> > cheapest(num_nodes);
+    for (auto i = 0ul; i < num_nodes; i++) {
+        parents[i].store(i, std::memory_order_relaxed);
+        cheapest[i].store(std::numeric_limits<std::uint64_t>::max(), std::memory_order_relaxed);
+    }
+
+    // Every chunk owns a slice of edges and a slice of nodes. Components
+    // merge unevenly, so there are a few chunks per thread to steal.
+    const auto edge_grain = pool->grain(edges.size());
+    const auto node_grain = pool->grain(num_nodes);
+    const auto num_edge_chunks = ThreadPool::num_chunks(edges.size(), edge_grain);
+    const auto num_node_chunks = ThreadPool::num_chunks(num_nodes, node_grain);
+    std::vector<std::vector<std::uint32_t> > active_edges(num_edge_chunks);
+    std::vector<std::vector<Edge> > chunk_mst_edges(num_node_chunks);
+    for (auto c = 0ul; c < num_edge_chunks; c++) {
+        const auto begin = c * edge_grain;
+        const auto end = std::min(edges.size(), begin + edge_grain);
+        active_edges[c].resize(end - begin);
+        std::iota(active_edges[c].begin(), active_edges[c].end(), (std::uint32_t) begin);
+    }
+
+    auto num_mst_edges = 0ul;
+    while (num_mst_edges < num_nodes - 1) {
+        // Cheapest outgoing edge of every component; edges inside a component are dropped
+        pool->parallel_for(edges.size(), edge_grain, [&] (std::size_t begin, std::size_t) {
+            auto &active = active_edges[begin / edge_grain];
+            auto kept = 0ul;
+            for (const auto e : active) {
+                const auto &edge = edges[e];
+                const auto a_root = find_root_atomic(parents, edge.a),
+                    b_root = find_root_atomic(parents, edge.b);
+                if (a_root == b_root) {
+                    continue;
+                }
+                active[kept++] = e;
+                const auto key = edge_key(edge.cost, e);
+                for (const auto root : { a_root, b_root }) {
+                    auto current = cheapest[root].load(std::memory_order_relaxed);
+                    while (key < current &&
+                           !cheapest[root].compare_exchange_weak(current, key, std::memory_order_relaxed));
+                }
+            }
+            active.resize(kept);
+        });
+
+        // Join components along their cheapest edges
+        std::vector<std::size_t> joined(num_node_chunks, 0);
+        pool->parallel_for(num_nodes, node_grain, [&] (std::size_t begin, std::size_t end) {
+            const auto c = begin / node_grain;
+            for (auto i = begin; i < end; i++) {
+                const auto key = cheapest[i].exchange(std::numeric_limits<std::uint64_t>::max(),
+                                                      std::memory_order_relaxed);
+                if (key == std::numeric_limits<std::uint64_t>::max()) {
+                    continue;
+                }
+                const auto &edge = edges[key & 0xffffffffu];
+                if (set_union_atomic(parents, edge.a, edge.b)) {
+                    chunk_mst_edges[c].push_back(edge);
+                    joined[c]++;
+                }
+            }
+        });
+
+        const auto joined_this_round = std::accumulate(joined.begin(), joined.end(), 0ul);
+        if (joined_this_round == 0) {
+            // Failed - the graph itself is not connected
+            break;
         }
+        num_mst_edges += joined_this_round;
     }
+
+    mst.edges.reserve(num_mst_edges);
+    for (const auto &chunk_edges : chunk_mst_edges) {
+        mst.edges.insert(mst.edges.end(), chunk_edges.begin(), chunk_edges.end());
+    }
+    return mst;
 }
 
+auto UGraph::adjacency() const -> Adjacency {
+    Adjacency adjacency;
+    adjacency.offsets.assign(num_nodes + 1, 0);
+    adjacency.neighbors.resize(edges.size() * 2);
+
+    // Count degrees, then turn them into row offsets
+    for (const auto &edge : edges) {
+        adjacency.offsets[edge.a + 1]++;
+        adjacency.offsets[edge.b + 1]++;
+    }
+    for (auto i = 0ul; i < num_nodes; i++) {
+        adjacency.offsets[i + 1] += adjacency.offsets[i];
+    }
+
+    std::vector<std::size_t> cursor(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+    for (const auto &edge : edges) {
+        adjacency.neighbors[cursor[edge.a]++] = edge.b;
+        adjacency.neighbors[cursor[edge.b]++] = edge.a;
+    }
+    return adjacency;
+}
+
+auto UGraph::traverse_dfs(int begin, std::function<void (int, int)> func) const -> void {
+    if (begin < 0 || begin >= num_nodes) {
+        return;
+    }
+    const auto adj = adjacency();
+    std::vector<bool> explored(num_nodes, false);
+
+    // Explicit stack of (node, reached from)
+    std::vector<std::pair<std::size_t, int> > stack;
+    stack.push_back({ begin, -1 });
+    explored[begin] = true;
+
+    while (!stack.empty()) {
+        const auto p = stack.back();
+        stack.pop_back();
+        func((int) p.first, p.second);
+
+        for (auto i = adj.offsets[p.first]; i < adj.offsets[p.first + 1]; i++) {
+            const auto neighbor = adj.neighbors[i];
+            if (!explored[neighbor]) {
+                explored[neighbor] = true;
+                stack.push_back({ neighbor, (int) p.first });
+            }
+        }
+    }
+}
@@ -11,15 +11,31 @@
 #include <vector>
 #include <mutex>
 #include <functional>
+#include "ThreadPool.hpp"
 
 
 typedef int EdgeIndex;
 
+enum class MSTAlgorithm {
+    // Sorts all edges, then joins them with union-find. Single threaded.
+    kruskal,
+    // Parallel rounds of cheapest-edge-per-component with lock-free union-find.
+    // Slower than Kruskal on one thread; `hoppe_bench mst` times both.
+    boruvka
+};
+
 struct Edge {
     std::size_t a, b;
     float cost;
 };
 
+/// Compressed sparse row adjacency: neighbors of node i are
+/// neighbors[offsets[i]] to neighbors[offsets[i + 1] - 1].
+struct Adjacency {
+    std::vector<std::size_t> offsets;
+    std::vector<std::size_t> neighbors;
+};
+
 class UGraph {
 public:
     UGraph(std::size_t num_nodes) : num_nodes(num_nodes) {}
@@ -36,13 +52,27 @@ public:
     
     auto clean_duplicate_edges() -> void;
     
-    auto generate_mst() -> UGraph;
+    /// Generates the minimal spanning tree (or forest, if the graph is not connected).
+    /// @param algorithm MST engine to use
+    /// @param pool threads for Boruvka; nullptr to start a pool just for this call
+    auto generate_mst(MSTAlgorithm algorithm = MSTAlgorithm::kruskal, ThreadPool *pool = nullptr) -> UGraph;
     
-    auto traverse_dfs(int begin, std::function<void(int)> func) const -> void;
+    /// Builds the CSR adjacency of the graph in O(N + E).
+    auto adjacency() const -> Adjacency;
+
+    /// Depth-first traversal in O(N + E).
+    /// @param begin node to start from
+    /// @param func called with each reached node and the node it was reached from (-1 for `begin`)
+    auto traverse_dfs(int begin, std::function<void(int, int)> func) const -> void;
     
     std::vector<Edge> edges;
     
     std::size_t num_nodes;
+
+private:
+    auto generate_mst_kruskal() -> UGraph;
+
+    auto generate_mst_boruvka(ThreadPool *pool) -> UGraph;
 };
 
 struct Subset {
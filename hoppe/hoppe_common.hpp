@@ -11,6 +11,7 @@
 #include <vector>
 #include <opencv2/core.hpp>
 #include <nanoflann.hpp>
+#include "UGraph.hpp"
 
 #define HOPPE_LOG_LEVEL 1
 
@@ -25,16 +26,60 @@
 #define POINT2VEC(p) cv::Vec3f(p.x, p.y, p.z)
 #define VEC2POINT(v) cv::Point3f(v(0), v(1), v(2))
 
+// Neighbors a NeighborBuffer holds in place before it needs the heap
+#define HOPPE_STACK_NEIGHBORS 64
+
 
 struct Plane {
     cv::Point3f origin;
     cv::Vec3f normal;
 };
 
+/// How the marching grid is kept in memory.
+enum class GridMode {
+    dense,      // the whole bounding box
+    sparse,     // 8^3 bricks covering the narrow band
+    streaming   // two z planes at a time, the mesh goes out as it is marched
+};
+
 struct Parameters {
     int k;
     float density, noise, isolevel;
     unsigned long max_volume;
+    MSTAlgorithm mst_algorithm;
+    bool narrow_band;
+    GridMode grid_mode;
+    // Threads shared by every parallel stage; 0 for one per hardware thread
+    unsigned int num_threads;
+    // Orient over the point neighborhoods found while estimating planes,
+    // instead of a second kNN pass over plane centers
+    bool shared_knn;
+    // Sort points along a Morton curve before estimating planes, so
+    // neighbors in space are neighbors in memory
+    bool spatial_order;
+};
+
+/// The parameters oriented tangent planes depend on. Planes are only reused
+/// while all of them stay the same.
+struct PlaneSettings {
+    // Neighborhood size, 0 while there are no planes
+    int k = 0;
+    MSTAlgorithm mst_algorithm = MSTAlgorithm::kruskal;
+    bool shared_knn = false;
+    bool spatial_order = false;
+
+    static auto of(const Parameters &parameters) -> PlaneSettings {
+        return { parameters.k, parameters.mst_algorithm, parameters.shared_knn, parameters.spatial_order };
+    }
+
+    auto operator==(const PlaneSettings &other) const -> bool {
+        return k == other.k && mst_algorithm == other.mst_algorithm &&
+            shared_knn == other.shared_knn && spatial_order == other.spatial_order;
+    }
+
+    auto operator!=(const PlaneSettings &other) const -> bool {
+        return !(*this == other);
+    }
 };
 
 class PointCloud {
@@ -98,4 +143,48 @@ typedef nanoflann::KDTreeSingleIndexAdaptor<
     3
 > PlaneCloudIndex;
 
+/// Result storage for k nearest neighbor queries, meant to live on a
+/// worker's stack and serve all of its queries. Up to HOPPE_STACK_NEIGHBORS
+/// neighbors are held in place; larger k allocate once, at construction.
+class NeighborBuffer {
+public:
+    explicit NeighborBuffer(std::size_t capacity) {
+        if (capacity > HOPPE_STACK_NEIGHBORS) {
+            heap_indices.resize(capacity);
+            heap_squared_dists.resize(capacity);
+        }
+    }
+
+    NeighborBuffer(const NeighborBuffer &) = delete;
+    auto operator=(const NeighborBuffer &) -> NeighborBuffer & = delete;
+
+    /// Finds the `k` nearest neighbors of `point`, nearest first.
+    /// @param index tree to search
+    /// @param point query coordinates
+    /// @param k number of neighbors, at most the capacity
+    /// @param out where to write neighbor indices, `indices()` if nullptr
+    /// @returns number of neighbors found, less than `k` only in small trees
+    template<typename Index>
+    inline auto knn(const Index &index, const float *point, std::size_t k, std::size_t *out = nullptr) -> std::size_t {
+        nanoflann::KNNResultSet<float, std::size_t> result(k);
+        result.init(out != nullptr ? out : indices(), squared_dists());
+        index.findNeighbors(result, point, nanoflann::SearchParams());
+        return result.size();
+    }
+
+    inline auto indices() -> std::size_t * {
+        return heap_indices.empty() ? stack_indices : heap_indices.data();
+    }
+
+    inline auto squared_dists() -> float * {
+        return heap_squared_dists.empty() ? stack_squared_dists : heap_squared_dists.data();
+    }
+
+private:
+    std::size_t stack_indices[HOPPE_STACK_NEIGHBORS];
+    float stack_squared_dists[HOPPE_STACK_NEIGHBORS];
+    std::vector<std::size_t> heap_indices;
+    std::vector<float> heap_squared_dists;
+};
+
 #endif /* hoppe_common_hpp */
@@ -12,8 +12,15 @@
 
 int main(int argc, const char * argv[]) {
     Hoppe hoppe;
-    hoppe.load_pointcloud("assets/bunny.xyz");
+    // The cache only stands in for the cloud it was built from
+    const auto cached = hoppe.load_cache("bunny.hoppe", "assets/bunny.xyz");
+    if (!cached) {
+        hoppe.load_pointcloud("assets/bunny.xyz");
+    }
+    hoppe.stream_mesh("result.obj");
     hoppe.run();
-    hoppe.export_mesh("result.obj");
+    if (!cached) {
+        hoppe.save_cache("bunny.hoppe");
+    }
     return 0;
 }